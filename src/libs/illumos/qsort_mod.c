@@ -1,6 +1,3 @@
-#if COUNTSWAPS
-extern unsigned long long tot_swaps;
-#endif
 /*
  * CDDL HEADER START
  *
@@ -32,10 +29,11 @@ extern unsigned long long tot_swaps;
 #include <stdint.h>
 #include <sys/types.h>
 
+/* shared swap kernels; they also count swapped bytes (COUNTSWAPS) */
+#include "../../qsorts/rdg/swap.h"
+
 static void swapp32(uint32_t *r1, uint32_t *r2, size_t cnt);
 static void swapp64(uint64_t *r1, uint64_t *r2, size_t cnt);
-static void swapi(uint32_t *r1, uint32_t *r2, size_t cnt);
-static void swapb(char *r1, char *r2, size_t cnt);
 
 /*
  * choose a median of 3 values
@@ -138,11 +136,11 @@ qsort(
 	 * based on the size and alignment of the data records
 	 *   swapp64	will swap 64 bit pointers
 	 *   swapp32	will swap 32 bit pointers
-	 *   swapi	will swap an array of 32 bit integers
-	 *   swapb	will swap an array of 8 bit characters
+	 *   swap_func	will swap records of any size and alignment
+	 *		(swap.h), in the widest moves available
 	 *
-	 * swapi and swapb will also require the variable loops to be set
-	 * to control the length of the array being swapped
+	 * swap_func will also require the variable loops to be set
+	 * to the length in bytes of the records being swapped
 	 */
 	if ((((uintptr_t)basep & (sizeof (uint64_t) - 1)) == 0) &&
 	    (rsiz == sizeof (uint64_t))) {
@@ -152,13 +150,9 @@ qsort(
 	    (rsiz == sizeof (uint32_t))) {
 		loops = 1;
 		swapf = (void (*)(char *, char *, size_t))swapp32;
-	} else if ((((uintptr_t)basep & (sizeof (uint32_t) - 1)) == 0) &&
-	    ((rsiz & (sizeof (uint32_t) - 1)) == 0)) {
-		loops = rsiz / sizeof (int);
-		swapf = (void (*)(char *, char *, size_t))swapi;
 	} else {
 		loops = rsiz;
-		swapf = swapb;
+		swapf = (void (*)(char *, char *, size_t))swap_func;
 	}
 
 	/*
@@ -472,58 +466,12 @@ qsort(
 static void
 swapp32(uint32_t *r1, uint32_t *r2, size_t cnt)
 {
-#if COUNTSWAPS
-tot_swaps += sizeof(uint32_t);
-#endif
-	uint32_t temp;
-
-	temp = *r1;
-	*r1++ = *r2;
-	*r2++ = temp;
+	swap_elems(r1, r2, sizeof (uint32_t));
 }
 
 /* ARGSUSED */
 static void
 swapp64(uint64_t *r1, uint64_t *r2, size_t cnt)
 {
-#if COUNTSWAPS
-tot_swaps += sizeof(uint64_t);
-#endif
-	uint64_t temp;
-
-	temp = *r1;
-	*r1++ = *r2;
-	*r2++ = temp;
-}
-
-static void
-swapi(uint32_t *r1, uint32_t *r2, size_t cnt)
-{
-#if COUNTSWAPS
-tot_swaps += sizeof(uint32_t) * cnt;
-#endif
-	uint32_t temp;
-
-	/* character by character */
-	while (cnt--) {
-		temp = *r1;
-		*r1++ = *r2;
-		*r2++ = temp;
-	}
-}
-
-static void
-swapb(char *r1, char *r2, size_t cnt)
-{
-#if COUNTSWAPS
-tot_swaps += cnt;
-#endif
-	char	temp;
-
-	/* character by character */
-	while (cnt--) {
-		temp = *r1;
-		*r1++ = *r2;
-		*r2++ = temp;
-	}
+	swap_elems(r1, r2, sizeof (uint64_t));
 }
@@ -0,0 +1,3 @@
+#define qsort qs22dp
+
+#include "qsorts/rdg/qs22dp.c"
@@ -0,0 +1,3 @@
+#define qsort qs22heap4
+
+#include "qsorts/rdg/qs22heap4.c"
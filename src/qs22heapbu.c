@@ -0,0 +1,3 @@
+#define qsort qs22heapbu
+
+#include "qsorts/rdg/qs22heapbu.c"
@@ -0,0 +1,3 @@
+#define qsort qs22ism
+
+#include "qsorts/rdg/qs22ism.c"
@@ -0,0 +1,4 @@
+#define qsort qs22jd
+#define INDIRECT 0
+
+#include "qsorts/rdg/qs22j.c"
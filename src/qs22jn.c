@@ -0,0 +1,4 @@
+#define qsort qs22jn
+#define SAMPLE_PIVOT 0
+
+#include "qsorts/rdg/qs22j.c"
@@ -0,0 +1,3 @@
+#define qsort qs22mc
+
+#include "qsorts/rdg/qs22mc.c"
@@ -0,0 +1 @@
+#include "qsorts/rdg/qs22mkqs.c"
@@ -0,0 +1,3 @@
+#define qsort qs22pdq
+
+#include "qsorts/rdg/qs22pdq.c"
@@ -0,0 +1 @@
+#include "qsorts/rdg/qs22radix.c"
@@ -0,0 +1,3 @@
+#define qsort qs22run
+
+#include "qsorts/rdg/qs22run.c"
@@ -0,0 +1,3 @@
+#define qsort qs22ssx
+
+#include "qsorts/rdg/qs22ssx.c"
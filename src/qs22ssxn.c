@@ -0,0 +1,4 @@
+#define qsort qs22ssxn
+#define NETWORK 1
+
+#include "qsorts/rdg/qs22ssx.c"
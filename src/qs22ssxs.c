@@ -0,0 +1,4 @@
+#define qsort qs22ssxs
+#define GAPS 2
+
+#include "qsorts/rdg/qs22ssx.c"
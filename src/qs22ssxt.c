@@ -0,0 +1,4 @@
+#define qsort qs22ssxt
+#define GAPS 1
+
+#include "qsorts/rdg/qs22ssx.c"
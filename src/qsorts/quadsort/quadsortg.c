@@ -0,0 +1,950 @@
+/*
+	Copyright (C) 2014-2021 Igor van den Hoven ivdhoven@gmail.com
+*/
+
+/*
+	Permission is hereby granted, free of charge, to any person obtaining
+	a copy of this software and associated documentation files (the
+	"Software"), to deal in the Software without restriction, including
+	without limitation the rights to use, copy, modify, merge, publish,
+	distribute, sublicense, and/or sell copies of the Software, and to
+	permit persons to whom the Software is furnished to do so, subject to
+	the following conditions:
+
+	The above copyright notice and this permission notice shall be
+	included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+	MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+	CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+	TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+	SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// quadsortg.c -- quadsort 1.1.5.2 (quadsort.c here) for elements of any
+// size, as a qsort(). quadsort.h compiles quadsort.c for each of five
+// element types, elements being moved by assignment; this is the same
+// algorithm on char * elements size bytes apart, moved by the copies and
+// swaps of ../rdg/swap.h, which are inline (and a few loads and stores)
+// for the common sizes, compiled separately as in qs22j. It is stable.
+//
+// Changes from quadsort.c, apart from the element type:
+//
+// - The swap[] arrays of up to 32 elements that quadsort.c declares on the
+//   stack, and its key and swap temporaries, are the front of the merge
+//   buffer, so the buffer is always at least 32 elements.
+// - parity_merge_two() and parity_merge_four() are parity_merge() with a
+//   block of 2 and 4, which is what they unroll.
+// - Compare-and-swap of neighbors is a branch and a swap, not quadsort's
+//   branchless three assignments, which would be three memcpy() calls
+//   for a size that isn't compiled in. The merges stay branchless.
+// - If no buffer of 32 elements can be allocated (and it doesn't fit the
+//   8K on the stack), the array is merged up from single elements by
+//   blit_merge(), with what fits on the stack as its buffer (see
+//   quadsortg_sort()). It rotates where the buffer is too small, so the
+//   sort stays stable, but it is O(n log^2 n) moves.
+//
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "../rdg/swap.h"
+
+#ifndef FIXED_SIZES
+#define FIXED_SIZES     1
+#endif
+#ifndef STACKBUF
+#define STACKBUF        8192        // bytes of merge buffer on the stack
+#endif
+
+#define INLINE inline __attribute__((always_inline))
+
+typedef int CMPFUNC (const void *a, const void *b);
+
+#define ELT(p, i)       ((p) + (i) * size)
+#define CPY(d, s)       swap_copy(d, s, size)
+#define CPYN(d, s, n)   swap_copy(d, s, (n) * size)
+#define SWP(a, b)       swap_elems(a, b, size)
+#define CSW(p)          do { if (cmp(p, (p) + size) > 0) SWP(p, (p) + size); } while (0)
+
+// One step of a branchless merge from the front: the lesser of *ptl and
+// *ptr (*ptl if equal) goes to pts[0], the other to pts[1], and only the
+// one taken is used up.
+#define HEAD_MERGE(ptl, ptr, pts) do { \
+		x = cmp(ptl, ptr) <= 0; y = !x; \
+		CPY((pts) + x * size, ptr); ptr += y * size; \
+		CPY((pts) + y * size, ptl); ptl += x * size; pts += size; \
+	} while (0)
+
+// The same from the back: the greater goes to pts[-1].
+#define TAIL_MERGE(ptl, ptr, pts) do { \
+		x = cmp(ptl, ptr) <= 0; y = !x; pts -= size; \
+		CPY((pts) + x * size, ptr); ptr -= x * size; \
+		CPY((pts) + y * size, ptl); ptl -= y * size; \
+	} while (0)
+
+// the next seven functions are used for sorting 0 to 31 elements
+
+static INLINE void unguarded_insert(char *array, size_t offset, size_t nmemb, char *key, size_t size, CMPFUNC *cmp)
+{
+	char *pta, *end;
+
+	for (size_t i = offset ; i < nmemb ; i++)
+	{
+		end = ELT(array, i);
+		pta = end - size;
+
+		if (cmp(pta, end) <= 0)
+		{
+			continue;
+		}
+		CPY(key, end);
+
+		if (cmp(array, key) > 0)
+		{
+			swap_move(array + size, array, i * size);
+			CPY(array, key);
+		}
+		else
+		{
+			do
+			{
+				CPY(end, pta);
+				end -= size;
+				pta -= size;
+			}
+			while (cmp(pta, key) > 0);
+
+			CPY(end, key);
+		}
+	}
+}
+
+static INLINE void bubble_sort(char *array, size_t nmemb, size_t size, CMPFUNC *cmp)
+{
+	if (nmemb > 1)
+	{
+		if (nmemb > 2)
+		{
+			CSW(array);
+			CSW(array + size);
+		}
+		CSW(array);
+	}
+}
+
+static INLINE void quad_swap_four(char *array, size_t size, CMPFUNC *cmp)
+{
+	char *pta = array;
+
+	CSW(pta);
+	CSW(pta + 2 * size);
+	pta += size;
+
+	if (cmp(pta, pta + size) > 0)
+	{
+		SWP(pta, pta + size);
+		pta -= size;
+		CSW(pta);
+		CSW(pta + 2 * size);
+		CSW(pta + size);
+	}
+}
+
+static INLINE void parity_merge(char *dest, char *from, size_t block, size_t nmemb, size_t size, CMPFUNC *cmp)
+{
+	char *ptl, *ptr, *tpl, *tpr, *tpd, *ptd;
+	size_t x, y;
+
+	ptl = from;
+	ptr = ELT(from, block);
+	ptd = dest;
+	tpl = ptr - size;
+	tpr = ELT(from, nmemb - 1);
+	tpd = ELT(dest, nmemb - 1);
+
+	for (block-- ; block ; block--)
+	{
+		HEAD_MERGE(ptl, ptr, ptd);
+		TAIL_MERGE(tpl, tpr, tpd);
+	}
+	CPY(ptd, cmp(ptl, ptr) <= 0 ? ptl : ptr);
+	CPY(tpd, cmp(tpl, tpr) > 0 ? tpl : tpr);
+}
+
+static INLINE void parity_swap_eight(char *array, char *swap, size_t size, CMPFUNC *cmp)
+{
+	CSW(ELT(array, 0));
+	CSW(ELT(array, 2));
+	CSW(ELT(array, 4));
+	CSW(ELT(array, 6));
+
+	if (cmp(ELT(array, 1), ELT(array, 2)) <= 0 && cmp(ELT(array, 3), ELT(array, 4)) <= 0 && cmp(ELT(array, 5), ELT(array, 6)) <= 0)
+	{
+		return;
+	}
+	parity_merge(swap, array, 2, 4, size, cmp);
+	parity_merge(ELT(swap, 4), ELT(array, 4), 2, 4, size, cmp);
+
+	parity_merge(array, swap, 4, 8, size, cmp);
+}
+
+static INLINE void parity_swap_sixteen(char *array, char *swap, size_t size, CMPFUNC *cmp)
+{
+	quad_swap_four(ELT(array, 0), size, cmp);
+	quad_swap_four(ELT(array, 4), size, cmp);
+	quad_swap_four(ELT(array, 8), size, cmp);
+	quad_swap_four(ELT(array, 12), size, cmp);
+
+	if (cmp(ELT(array, 3), ELT(array, 4)) <= 0 && cmp(ELT(array, 7), ELT(array, 8)) <= 0 && cmp(ELT(array, 11), ELT(array, 12)) <= 0)
+	{
+		return;
+	}
+	parity_merge(swap, array, 4, 8, size, cmp);
+	parity_merge(ELT(swap, 8), ELT(array, 8), 4, 8, size, cmp);
+
+	parity_merge(array, swap, 8, 16, size, cmp);
+}
+
+static INLINE void tail_swap(char *array, size_t nmemb, char *swap, size_t size, CMPFUNC *cmp)
+{
+	if (nmemb < 4)
+	{
+		bubble_sort(array, nmemb, size, cmp);
+		return;
+	}
+	if (nmemb < 8)
+	{
+		quad_swap_four(array, size, cmp);
+		unguarded_insert(array, 4, nmemb, swap, size, cmp);
+		return;
+	}
+	if (nmemb < 16)
+	{
+		parity_swap_eight(array, swap, size, cmp);
+		unguarded_insert(array, 8, nmemb, swap, size, cmp);
+		return;
+	}
+	parity_swap_sixteen(array, swap, size, cmp);
+	unguarded_insert(array, 16, nmemb, swap, size, cmp);
+}
+
+// the next three functions create sorted blocks of 32 elements
+
+static INLINE void parity_tail_swap_eight(char *array, char *swap, size_t size, CMPFUNC *cmp)
+{
+	CSW(ELT(array, 4));
+
+	if (cmp(ELT(array, 6), ELT(array, 7)) > 0)
+	{
+		SWP(ELT(array, 6), ELT(array, 7));
+	}
+	else if (cmp(ELT(array, 3), ELT(array, 4)) <= 0 && cmp(ELT(array, 5), ELT(array, 6)) <= 0)
+	{
+		return;
+	}
+	CPYN(swap, array, 4);
+
+	parity_merge(ELT(swap, 4), ELT(array, 4), 2, 4, size, cmp);
+
+	parity_merge(array, swap, 4, 8, size, cmp);
+}
+
+static INLINE void parity_tail_flip_eight(char *array, char *swap, size_t size, CMPFUNC *cmp)
+{
+	if (cmp(ELT(array, 3), ELT(array, 4)) <= 0)
+	{
+		return;
+	}
+	CPYN(swap, array, 8);
+
+	parity_merge(array, swap, 4, 8, size, cmp);
+}
+
+// Reverse pts[0] to pte[0].
+static INLINE void reverse(char *pts, char *pte, size_t size)
+{
+	size_t n = (pte - pts) / size / 2;
+
+	do
+	{
+		SWP(pts, pte);
+		pts += size;
+		pte -= size;
+	}
+	while (n--);
+}
+
+static void tail_merge(char *array, char *swap, size_t swap_size, size_t nmemb, size_t block, size_t size, CMPFUNC *cmp);
+
+static INLINE size_t quad_swap(char *array, size_t nmemb, char *swap, size_t size, CMPFUNC *cmp)
+{
+	size_t count;
+	char *pta, *pts;
+
+	pta = array;
+
+	count = nmemb / 8 * 2;
+
+	while (count--)
+	{
+		switch ((cmp(ELT(pta, 0), ELT(pta, 1)) > 0) | (cmp(ELT(pta, 1), ELT(pta, 2)) > 0) * 2 | (cmp(ELT(pta, 2), ELT(pta, 3)) > 0) * 4)
+		{
+			case 0:
+				break;
+			case 1:
+				SWP(ELT(pta, 0), ELT(pta, 1));
+				CSW(ELT(pta, 1));
+				CSW(ELT(pta, 2));
+				break;
+			case 2:
+				SWP(ELT(pta, 1), ELT(pta, 2));
+				CSW(ELT(pta, 0));
+				CSW(ELT(pta, 2));
+				CSW(ELT(pta, 1));
+				break;
+			case 3:
+				SWP(ELT(pta, 0), ELT(pta, 2));
+				CSW(ELT(pta, 2));
+				CSW(ELT(pta, 1));
+				break;
+			case 4:
+				SWP(ELT(pta, 2), ELT(pta, 3));
+				CSW(ELT(pta, 1));
+				CSW(ELT(pta, 0));
+				break;
+			case 5:
+				SWP(ELT(pta, 0), ELT(pta, 1));
+				SWP(ELT(pta, 2), ELT(pta, 3));
+				CSW(ELT(pta, 1));
+				CSW(ELT(pta, 2));
+				CSW(ELT(pta, 0));
+				break;
+			case 6:
+				SWP(ELT(pta, 1), ELT(pta, 3));
+				CSW(ELT(pta, 0));
+				CSW(ELT(pta, 1));
+				break;
+			case 7:
+				pts = pta;
+				goto swapper;
+		}
+		count--;
+
+		parity_tail_swap_eight(pta, swap, size, cmp);
+
+		pta = ELT(pta, 8);
+
+		continue;
+
+		swapper:
+
+		pta = ELT(pta, 4);
+
+		if (count--)
+		{
+			if (cmp(ELT(pta, 0), ELT(pta, 1)) > 0)
+			{
+				if (cmp(ELT(pta, 2), ELT(pta, 3)) > 0)
+				{
+					if (cmp(ELT(pta, 1), ELT(pta, 2)) > 0)
+					{
+						if (cmp(pta - size, ELT(pta, 0)) > 0)
+						{
+							goto swapper;
+						}
+					}
+					SWP(ELT(pta, 2), ELT(pta, 3));
+				}
+				SWP(ELT(pta, 0), ELT(pta, 1));
+			}
+			else if (cmp(ELT(pta, 2), ELT(pta, 3)) > 0)
+			{
+				SWP(ELT(pta, 2), ELT(pta, 3));
+			}
+
+			if (cmp(ELT(pta, 1), ELT(pta, 2)) > 0)
+			{
+				SWP(ELT(pta, 1), ELT(pta, 2));
+				CSW(ELT(pta, 0));
+				CSW(ELT(pta, 2));
+				CSW(ELT(pta, 1));
+			}
+			reverse(pts, pta - size, size);
+
+			if (count % 2 == 0)
+			{
+				pta -= 4 * size;
+
+				parity_tail_flip_eight(pta, swap, size, cmp);
+			}
+			else
+			{
+				count--;
+
+				parity_tail_swap_eight(pta, swap, size, cmp);
+			}
+			pta = ELT(pta, 8);
+
+			continue;
+		}
+
+		if (pts == array)
+		{
+			switch (nmemb % 8)
+			{
+				case 7: if (cmp(ELT(pta, 5), ELT(pta, 6)) <= 0) break; // fall through
+				case 6: if (cmp(ELT(pta, 4), ELT(pta, 5)) <= 0) break; // fall through
+				case 5: if (cmp(ELT(pta, 3), ELT(pta, 4)) <= 0) break; // fall through
+				case 4: if (cmp(ELT(pta, 2), ELT(pta, 3)) <= 0) break; // fall through
+				case 3: if (cmp(ELT(pta, 1), ELT(pta, 2)) <= 0) break; // fall through
+				case 2: if (cmp(ELT(pta, 0), ELT(pta, 1)) <= 0) break; // fall through
+				case 1: if (cmp(pta - size, ELT(pta, 0)) <= 0) break; // fall through
+				case 0:
+					reverse(pts, ELT(pts, nmemb - 1), size);
+
+					return 1;
+			}
+		}
+		reverse(pts, pta - size, size);
+
+		break;
+	}
+
+	tail_swap(pta, nmemb % 8, swap, size, cmp);
+
+	pta = array;
+
+	for (count = nmemb / 32 ; count-- ; pta = ELT(pta, 32))
+	{
+		if (cmp(ELT(pta, 7), ELT(pta, 8)) <= 0 && cmp(ELT(pta, 15), ELT(pta, 16)) <= 0 && cmp(ELT(pta, 23), ELT(pta, 24)) <= 0)
+		{
+			continue;
+		}
+		parity_merge(swap, pta, 8, 16, size, cmp);
+		parity_merge(ELT(swap, 16), ELT(pta, 16), 8, 16, size, cmp);
+		parity_merge(pta, swap, 16, 32, size, cmp);
+	}
+
+	if (nmemb % 32 > 8)
+	{
+		tail_merge(pta, swap, 32, nmemb % 32, 8, size, cmp);
+	}
+	return 0;
+}
+
+// quad merge support routines
+
+static INLINE void forward_merge(char *dest, char *from, size_t block, size_t size, CMPFUNC *cmp)
+{
+	char *ptl, *ptr, *m, *e; // left, right, middle, end
+	size_t x, y;
+
+	ptl = from;
+	ptr = ELT(from, block);
+	m = ptr;
+	e = ELT(ptr, block);
+
+	if (cmp(m - size, e - block / 4 * size) <= 0)
+	{
+		m -= 2 * size;
+
+		while (ptl < m)
+		{
+			if (cmp(ptl + size, ptr) <= 0)
+			{
+				CPYN(dest, ptl, 2); dest += 2 * size; ptl += 2 * size;
+			}
+			else if (cmp(ptl, ptr + size) > 0)
+			{
+				CPYN(dest, ptr, 2); dest += 2 * size; ptr += 2 * size;
+			}
+			else
+			{
+				x = cmp(ptl, ptr) <= 0; y = !x; CPY(dest + x * size, ptr); ptr += size; CPY(dest + y * size, ptl); ptl += size; dest += 2 * size;
+				HEAD_MERGE(ptl, ptr, dest);
+			}
+		}
+		m += 2 * size;
+
+		while (ptl < m)
+		{
+			if (cmp(ptl, ptr) <= 0)
+			{
+				CPY(dest, ptl); ptl += size;
+			}
+			else
+			{
+				CPY(dest, ptr); ptr += size;
+			}
+			dest += size;
+		}
+		CPYN(dest, ptr, (e - ptr) / size);
+	}
+	else if (cmp(m - block / 4 * size, e - size) > 0)
+	{
+		e -= 2 * size;
+
+		while (ptr < e)
+		{
+			if (cmp(ptl, ptr + size) > 0)
+			{
+				CPYN(dest, ptr, 2); dest += 2 * size; ptr += 2 * size;
+			}
+			else if (cmp(ptl + size, ptr) <= 0)
+			{
+				CPYN(dest, ptl, 2); dest += 2 * size; ptl += 2 * size;
+			}
+			else
+			{
+				x = cmp(ptl, ptr) <= 0; y = !x; CPY(dest + x * size, ptr); ptr += size; CPY(dest + y * size, ptl); ptl += size; dest += 2 * size;
+				HEAD_MERGE(ptl, ptr, dest);
+			}
+		}
+		e += 2 * size;
+
+		while (ptr < e)
+		{
+			if (cmp(ptl, ptr) > 0)
+			{
+				CPY(dest, ptr); ptr += size;
+			}
+			else
+			{
+				CPY(dest, ptl); ptl += size;
+			}
+			dest += size;
+		}
+		CPYN(dest, ptl, (m - ptl) / size);
+	}
+	else
+	{
+		parity_merge(dest, from, block, block * 2, size, cmp);
+	}
+}
+
+// main memory: [A][B][C][D]
+// swap memory: [A  B]       step 1
+// swap memory: [A  B][C  D] step 2
+// main memory: [A  B  C  D] step 3
+
+static INLINE void quad_merge_block(char *array, char *swap, size_t block, size_t size, CMPFUNC *cmp)
+{
+	char *c_max;
+	size_t block_x_2 = block * 2;
+
+	c_max = ELT(array, block);
+
+	if (cmp(c_max - size, c_max) <= 0)
+	{
+		c_max = ELT(c_max, block_x_2);
+
+		if (cmp(c_max - size, c_max) <= 0)
+		{
+			c_max -= block * size;
+
+			if (cmp(c_max - size, c_max) <= 0)
+			{
+				return;
+			}
+			CPYN(swap, array, block * 4); // steps 1 and 2
+
+			forward_merge(array, swap, block_x_2, size, cmp); // step 3
+
+			return;
+		}
+		CPYN(swap, array, block_x_2); // step 1
+	}
+	else
+	{
+		forward_merge(swap, array, block, size, cmp); // step 1
+	}
+	forward_merge(ELT(swap, block_x_2), ELT(array, block_x_2), block, size, cmp); // step 2
+
+	forward_merge(array, swap, block_x_2, size, cmp); // step 3
+}
+
+static INLINE size_t quad_merge(char *array, char *swap, size_t swap_size, size_t nmemb, size_t block, size_t size, CMPFUNC *cmp)
+{
+	char *pta, *pte;
+
+	pte = ELT(array, nmemb);
+
+	block *= 4;
+
+	while (block <= nmemb && block <= swap_size)
+	{
+		pta = array;
+
+		do
+		{
+			quad_merge_block(pta, swap, block / 4, size, cmp);
+
+			pta = ELT(pta, block);
+		}
+		while (ELT(pta, block) <= pte);
+
+		tail_merge(pta, swap, swap_size, (pte - pta) / size, block / 4, size, cmp);
+
+		block *= 4;
+	}
+
+	tail_merge(array, swap, swap_size, nmemb, block / 4, size, cmp);
+
+	return block / 2;
+}
+
+static INLINE void partial_forward_merge(char *array, char *swap, size_t nmemb, size_t block, size_t size, CMPFUNC *cmp)
+{
+	char *r, *m, *e, *s; // right, middle, end, swap
+	size_t x, y;
+
+	r = ELT(array, block);
+	e = ELT(array, nmemb - 1);
+
+	CPYN(swap, array, block);
+
+	s = swap;
+	m = ELT(swap, block - 1);
+
+	while (s + 2 * size <= m && r + 2 * size <= e)
+	{
+		if (cmp(s, r + size) > 0)
+		{
+			CPYN(array, r, 2); array += 2 * size; r += 2 * size;
+		}
+		else if (cmp(s + size, r) <= 0)
+		{
+			CPYN(array, s, 2); array += 2 * size; s += 2 * size;
+		}
+		else
+		{
+			x = cmp(s, r) <= 0; y = !x; CPY(array + x * size, r); r += size; CPY(array + y * size, s); s += size; array += 2 * size;
+			HEAD_MERGE(s, r, array);
+		}
+	}
+
+	while (s <= m && r <= e)
+	{
+		if (cmp(s, r) <= 0)
+		{
+			CPY(array, s); s += size;
+		}
+		else
+		{
+			CPY(array, r); r += size;
+		}
+		array += size;
+	}
+
+	if (s <= m)
+	{
+		CPYN(array, s, (m - s) / size + 1);
+	}
+}
+
+static INLINE void partial_backward_merge(char *array, char *swap, size_t nmemb, size_t block, size_t size, CMPFUNC *cmp)
+{
+	char *m, *e, *s; // middle, end, swap
+	size_t x, y;
+
+	m = ELT(array, block - 1);
+	e = ELT(array, nmemb - 1);
+
+	if (cmp(m, m + size) <= 0)
+	{
+		return;
+	}
+
+	CPYN(swap, m + size, nmemb - block);
+
+	s = ELT(swap, nmemb - block - 1);
+
+	// s and m are kept one element up from quadsort.c's, so as not to point
+	// before the arrays.
+	s += size;
+	m += size;
+	e += size;
+
+	while (s >= swap + 3 * size && m >= array + 3 * size)
+	{
+		if (cmp(m - 2 * size, s - size) > 0)
+		{
+			e -= 2 * size; m -= 2 * size; CPYN(e, m, 2);
+		}
+		else if (cmp(m - size, s - 2 * size) <= 0)
+		{
+			e -= 2 * size; s -= 2 * size; CPYN(e, s, 2);
+		}
+		else
+		{
+			char *ml = m - size, *sl = s - size;
+			x = cmp(ml, sl) <= 0; y = !x; e -= 2 * size; CPY(e + x * size, sl); s -= size; CPY(e + y * size, ml); m -= size;
+			ml = m - size; sl = s - size;
+			x = cmp(ml, sl) <= 0; y = !x; e -= size; CPY(e - size + x * size, sl); s -= x * size; CPY(e - size + y * size, ml); m -= y * size;
+		}
+	}
+
+	while (s > swap && m > array)
+	{
+		e -= size;
+		if (cmp(m - size, s - size) > 0)
+		{
+			m -= size; CPY(e, m);
+		}
+		else
+		{
+			s -= size; CPY(e, s);
+		}
+	}
+
+	if (s > swap)
+	{
+		CPYN(e - (s - swap), swap, (s - swap) / size);
+	}
+}
+
+static void tail_merge(char *array, char *swap, size_t swap_size, size_t nmemb, size_t block, size_t size, CMPFUNC *cmp)
+{
+	char *pta, *pte;
+
+	pte = ELT(array, nmemb);
+
+	while (block < nmemb && block <= swap_size)
+	{
+		for (pta = array ; ELT(pta, block) < pte ; pta = ELT(pta, block * 2))
+		{
+			if (ELT(pta, block * 2) < pte)
+			{
+				partial_backward_merge(pta, swap, block * 2, block, size, cmp);
+
+				continue;
+			}
+			partial_backward_merge(pta, swap, (pte - pta) / size, block, size, cmp);
+
+			break;
+		}
+		block *= 2;
+	}
+}
+
+// the next four functions provide in-place rotate merge support
+
+// Exchange array[0..left) and array[left..nmemb). quadsort.c also has an
+// in-place 4-way exchange for when the shorter part doesn't fit the
+// buffer; here that case is done by reversals.
+static void trinity_rotation(char *array, char *swap, size_t swap_size, size_t nmemb, size_t left, size_t size)
+{
+	size_t right = nmemb - left;
+
+	if (left < right && left <= swap_size)
+	{
+		CPYN(swap, array, left);
+		swap_move(array, ELT(array, left), right * size);
+		CPYN(ELT(array, right), swap, left);
+	}
+	else if (right < left && right <= swap_size)
+	{
+		CPYN(swap, ELT(array, left), right);
+		swap_move(ELT(array, right), array, left * size);
+		CPYN(array, swap, right);
+	}
+	else if (left == right)
+	{
+		swap_func(array, ELT(array, left), left * size);
+	}
+	else
+	{
+		reverse(array, ELT(array, left - 1), size);
+		reverse(ELT(array, left), ELT(array, nmemb - 1), size);
+		reverse(array, ELT(array, nmemb - 1), size);
+	}
+}
+
+static INLINE size_t monobound_binary_first(char *array, char *value, size_t top, size_t size, CMPFUNC *cmp)
+{
+	char *end;
+	size_t mid;
+
+	end = ELT(array, top);
+
+	while (top > 1)
+	{
+		mid = top / 2;
+
+		if (cmp(value, end - mid * size) <= 0)
+		{
+			end -= mid * size;
+		}
+		top -= mid;
+	}
+
+	if (cmp(value, end - size) <= 0)
+	{
+		end -= size;
+	}
+	return (end - array) / size;
+}
+
+static void blit_merge_block(char *array, char *swap, size_t swap_size, size_t block, size_t right, size_t size, CMPFUNC *cmp)
+{
+	size_t left;
+
+	if (cmp(ELT(array, block - 1), ELT(array, block)) <= 0)
+	{
+		return;
+	}
+
+	if (block == 1) // one element; rotate it into place
+	{
+		left = monobound_binary_first(ELT(array, 1), array, right, size, cmp);
+
+		trinity_rotation(array, swap, swap_size, left + 1, 1, size);
+
+		return;
+	}
+
+	left = monobound_binary_first(ELT(array, block), ELT(array, block / 2), right, size, cmp);
+
+	right -= left;
+
+	block /= 2;
+
+	if (left)
+	{
+		trinity_rotation(ELT(array, block), swap, swap_size, block + left, block, size);
+
+		if (left <= swap_size)
+		{
+			partial_backward_merge(array, swap, block + left, block, size, cmp);
+		}
+		else if (block <= swap_size)
+		{
+			partial_forward_merge(array, swap, block + left, block, size, cmp);
+		}
+		else
+		{
+			blit_merge_block(array, swap, swap_size, block, left, size, cmp);
+		}
+	}
+
+	if (right)
+	{
+		if (right <= swap_size)
+		{
+			partial_backward_merge(ELT(array, block + left), swap, block + right, block, size, cmp);
+		}
+		else if (block <= swap_size)
+		{
+			partial_forward_merge(ELT(array, block + left), swap, block + right, block, size, cmp);
+		}
+		else
+		{
+			blit_merge_block(ELT(array, block + left), swap, swap_size, block, right, size, cmp);
+		}
+	}
+}
+
+static INLINE void blit_merge(char *array, char *swap, size_t swap_size, size_t nmemb, size_t block, size_t size, CMPFUNC *cmp)
+{
+	char *pta, *pte;
+
+	pte = ELT(array, nmemb);
+
+	while (block < nmemb)
+	{
+		for (pta = array ; ELT(pta, block) < pte ; pta = ELT(pta, block * 2))
+		{
+			if (ELT(pta, block * 2) < pte)
+			{
+				blit_merge_block(pta, swap, swap_size, block, block, size, cmp);
+
+				continue;
+			}
+			blit_merge_block(pta, swap, swap_size, block, (pte - pta) / size - block, size, cmp);
+
+			break;
+		}
+		block *= 2;
+	}
+}
+
+static INLINE void quadsortg_sort(char *array, size_t nmemb, size_t size, CMPFUNC *cmp)
+{
+	union { char c[STACKBUF]; swap_align_t a; } stackbuf; // for cmp
+	char *stack = stackbuf.c, *swap;
+	size_t swap_size = 32;
+
+	if (nmemb < 32)
+	{
+		if (size * 16 <= STACKBUF)
+		{
+			tail_swap(array, nmemb, stack, size, cmp);
+			return;
+		}
+		swap = malloc(16 * size);
+		if (swap == NULL)
+		{
+			blit_merge(array, stack, STACKBUF / size, nmemb, 1, size, cmp);
+			return;
+		}
+		tail_swap(array, nmemb, swap, size, cmp);
+		free(swap);
+		return;
+	}
+
+	while (swap_size * 4 <= nmemb)
+	{
+		swap_size *= 4;
+	}
+	swap = malloc(swap_size * size);
+
+	if (swap == NULL)
+	{
+		swap_size = STACKBUF / size;
+		swap = stack;
+
+		// Too little for quad_swap(); merge up from single elements,
+		// by rotations where the buffer is too small (as upstream does
+		// with its rotate_merge() when malloc() fails).
+		if (swap_size < 32)
+		{
+			blit_merge(array, swap, swap_size, nmemb, 1, size, cmp);
+			return;
+		}
+		if (quad_swap(array, nmemb, swap, size, cmp) == 0)
+		{
+			tail_merge(array, swap, swap_size, nmemb, 32, size, cmp);
+
+			blit_merge(array, swap, swap_size, nmemb, 64, size, cmp);
+		}
+		return;
+	}
+	if (quad_swap(array, nmemb, swap, size, cmp) == 0)
+	{
+		quad_merge(array, swap, swap_size, nmemb, 32, size, cmp);
+
+		blit_merge(array, swap, swap_size, nmemb, swap_size * 2, size, cmp);
+	}
+	free(swap);
+}
+
+void qsort(void *base, size_t nmemb, size_t size,
+                                     int (*compar)(const void *, const void *))
+{
+#if FIXED_SIZES
+#define FIXEDSIZE(n) case n: quadsortg_sort(base, nmemb, n, compar); return;
+	switch (size)
+	{
+		FIXEDSIZE(4)
+		FIXEDSIZE(8)
+		FIXEDSIZE(12)
+		FIXEDSIZE(16)
+		FIXEDSIZE(24)
+		FIXEDSIZE(32)
+	}
+#undef FIXEDSIZE
+#endif
+	quadsortg_sort(base, nmemb, size, compar);
+}
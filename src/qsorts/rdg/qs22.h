@@ -0,0 +1,111 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22.h -- sorts from the qs22 family that don't have the qsort() interface.
+//
+#ifndef QS22_H
+#define QS22_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Typed sorts (qs22typed.c): ascending order, not stable. NaNs go last in
+// qs22_sort_f64().
+void qs22_sort_i32(int32_t *base, size_t nmemb);
+void qs22_sort_i64(int64_t *base, size_t nmemb);
+void qs22_sort_u32(uint32_t *base, size_t nmemb);
+void qs22_sort_u64(uint64_t *base, size_t nmemb);
+void qs22_sort_f64(double *base, size_t nmemb);
+
+// Radix sort (qs22radix.c) on the keys key_fn() gives for the elements; see
+// the qs22_key_*() functions below. Stable. Returns 0, or -1 with errno
+// ENOMEM (and the array unchanged) if it can't get scratch space.
+int qs22_radix_sort(void *base, size_t nmemb, size_t size,
+        uint64_t (*key_fn)(const void *));
+
+// MSD radix sort (American flag sort, qs22afsort.c) of pointers to
+// NUL-terminated strings, in strcmp() order. In place; not stable.
+void qs22_afsort_str(char **base, size_t nmemb);
+
+// Multikey quicksort (qs22mkqs.c) of pointers to NUL-terminated strings, in
+// strcmp() order. In place; not stable.
+void qs22_mkqsort_str(char **base, size_t nmemb);
+
+// Stable merge (qs22mergeip.c) of the sorted runs base[0..n1) and
+// base[n1..n1+n2) into one, in place. scratch, if not NULL, is scratch_size
+// bytes it may use; with room for the shorter run it takes O(n) time, else
+// it merges by rotations, in O(n log n).
+void qs22_merge_inplace(void *base, size_t n1, size_t n2, size_t size,
+        int (*compar)(const void *, const void *),
+        void *scratch, size_t scratch_size);
+
+// qs22j's sort loop (qs22j.c) run on base[0..nmemb) as one piece of a bigger
+// sort that shares out its subfiles among threads (qs22j_par.c). sh->depth
+// is the partitioning depth base is at, for the introsort limit
+// sh->maxdepth. Parts of at least sh->minshare elements that the loop would
+// stack to sort later are passed to sh->share() instead, with their depth.
+typedef struct qs22j_share {
+    size_t minshare;
+    void (*share)(struct qs22j_share *sh, void *base, size_t nmemb,
+            int depth);
+    void *ctx;                      // for share()
+    int depth, maxdepth;
+} qs22j_share;
+
+void qs22j_sub(void *base, size_t nmemb, size_t size,
+        int (*compar)(const void *, const void *), qs22j_share *sh);
+
+// Sort base[0..n_sorted+k_new), where only base[0..n_sorted) is in order
+// already, by sorting the rest with qs22j and merging it in (qs22mergeip.c).
+// Not stable. About k lg n compares for k_new = k much less than n.
+void qs22_resort_tail(void *base, size_t n_sorted, size_t k_new, size_t size,
+        int (*compar)(const void *, const void *));
+
+// Merge (qs22kmerge.c) of the k runs runs[i], of counts[i] elements each,
+// sorted by compar(), to out, which must not overlap them. A tree of losers
+// makes about lg k compares per element; stretches of one run that come
+// before all the others are found by galloping and copied as blocks. Stable,
+// in run order. Returns 0, or -1 with errno ENOMEM if it can't get space
+// for the tree (k over 64).
+int qs22_kmerge(const void *const runs[], const size_t counts[], size_t k,
+        size_t size, int (*compar)(const void *, const void *), void *out);
+
+// The same, for runs sorted by the keys key_fn() gives, as for
+// qs22_radix_sort(); key_fn() is called about once per element.
+int qs22_kmerge_key(const void *const runs[], const size_t counts[],
+        size_t k, size_t size, uint64_t (*key_fn)(const void *), void *out);
+
+// Order-preserving uint64 keys for signed ints and doubles. Negative doubles
+// have all bits flipped, others only the sign bit, so -0.0 comes just before
+// 0.0 and NaNs go to the ends (by their sign bit).
+static inline uint64_t qs22_key_i32(int32_t x)
+{
+    return (uint32_t)x ^ 0x80000000u;
+}
+
+static inline uint64_t qs22_key_i64(int64_t x)
+{
+    return (uint64_t)x ^ ((uint64_t)1 << 63);
+}
+
+static inline uint64_t qs22_key_f64(double x)
+{
+    uint64_t u;
+    memcpy(&u, &x, sizeof u);
+    return u ^ (-(u >> 63) | ((uint64_t)1 << 63));
+}
+
+#endif
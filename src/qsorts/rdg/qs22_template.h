@@ -0,0 +1,224 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22_template.h -- qs22j for one element type, with the compare inlined and
+// the elements moved by assignment, instead of calls through compar and the
+// swap function. Like quadsort.h with VAR/FUNC, but one macro call makes the
+// whole sort:
+//
+//  QS22_DEFINE(name, TYPE, LESS_EXPR)
+//
+// defines static void name(TYPE *base, size_t nmemb), which sorts base[] in
+// ascending order (not stable). LESS_EXPR is true when the element at a
+// comes before the one at b, where a and b are TYPE const *, e.g.
+//
+//  QS22_DEFINE(sort_int, int, *a < *b)
+//  QS22_DEFINE(sort_recs, struct rec, a->key < b->key)
+//
+// It also defines the type name_t and static helpers named name_*. LESS_EXPR
+// must be a strict weak order (a NaN among doubles compared with < is not).
+// With COUNTSWAPS, each element copied counts as a swap of sizeof(TYPE) bytes.
+//
+// Pivot choice is as in qs22j: middle element, median of 3, or median of 3
+// medians of 3 as the subfile grows, with a presorted check on each subfile
+// and heapsort when partitioning goes too deep. With only a less-than test,
+// the fat partition of qs22j would take two compares per element, so
+// duplicates are handled as in qs22typed.c (and pdqsort) instead: elements
+// equal to the pivot go right, and a subfile whose pivot equals the element
+// before it has the elements equal to it split off and dropped.
+//
+#ifndef QS22_TEMPLATE_H
+#define QS22_TEMPLATE_H
+
+#include <stddef.h>
+
+#ifndef QS22T_INSORTTHRESH
+#define QS22T_INSORTTHRESH  16      // if n < this use insertion sort
+#endif
+#define QS22T_MIDTHRESH     20      // < this use middle as pivot
+#define QS22T_MEDOF3THRESH  50      // < this use median-of-3 as pivot
+
+#if COUNTSWAPS
+extern unsigned long long tot_swaps;
+#define QS22T_COUNTSWAP(n)  (tot_swaps += (n))
+#else
+#define QS22T_COUNTSWAP(n)  ((void)0)
+#endif
+
+#define QS22_DEFINE(name, TYPE, LESS_EXPR) \
+ \
+/* TYPE may be e.g. char *, so declarations use a typedef name for it. */ \
+typedef TYPE name##_t; \
+ \
+static inline int name##_less(name##_t const *a, name##_t const *b) \
+{ \
+    return LESS_EXPR; \
+} \
+ \
+static inline void name##_swap(name##_t *a, name##_t *b) \
+{ \
+    name##_t t = *a; \
+    *a = *b; \
+    *b = t; \
+    QS22T_COUNTSWAP(sizeof(name##_t)); \
+} \
+ \
+/* Insertion sort, moving a hole down rather than swapping. */ \
+static void name##_insertion_sort(name##_t *lo, name##_t *hi) \
+{ \
+    for (name##_t *i = lo + 1; i < hi; i++) { \
+        if (! name##_less(i, i - 1)) \
+            continue; \
+        name##_t t = *i, *j = i; \
+        do { \
+            *j = j[-1]; \
+            j--; \
+        } while (j != lo && name##_less(&t, j - 1)); \
+        *j = t; \
+        QS22T_COUNTSWAP((i - j + 2) * sizeof(name##_t)); \
+    } \
+} \
+ \
+/* Floyd's treesort3, for subfiles partitioned too deep (introsort). */ \
+static void name##_heapsort(name##_t *a, size_t n) \
+{ \
+    for (size_t k = n / 2, m = n; m > 1; ) { \
+        name##_t t; \
+        if (k) { \
+            t = a[--k]; \
+        } else { \
+            t = a[--m]; \
+            a[m] = a[0]; \
+        } \
+        size_t i = k, j; \
+        while ((j = 2 * i + 1) < m) { \
+            if (j + 1 < m && name##_less(&a[j], &a[j + 1])) \
+                j++; \
+            if (! name##_less(&t, &a[j])) \
+                break; \
+            a[i] = a[j]; \
+            i = j; \
+            QS22T_COUNTSWAP(sizeof(name##_t)); \
+        } \
+        a[i] = t; \
+        QS22T_COUNTSWAP(2 * sizeof(name##_t)); \
+    } \
+} \
+ \
+static name##_t *name##_med3(name##_t *a, name##_t *b, name##_t *c) \
+{ \
+    return name##_less(a, b) ? \
+        (name##_less(b, c) ? b : name##_less(a, c) ? c : a) : \
+        (name##_less(c, b) ? b : name##_less(c, a) ? c : a); \
+} \
+ \
+/* Partition a[0..n) around *pv (not in a[]): those less than it, or not */ \
+/* greater if le, first. Returns the number of those. */ \
+static size_t name##_partition(name##_t *a, size_t n, name##_t const *pv, int le) \
+{ \
+    name##_t *i = a, *j = a + n; \
+    for (;;) { \
+        if (le) { \
+            while (i < j && ! name##_less(pv, i)) \
+                i++; \
+            while (i < j && name##_less(pv, j - 1)) \
+                j--; \
+        } else { \
+            while (i < j && name##_less(i, pv)) \
+                i++; \
+            while (i < j && ! name##_less(j - 1, pv)) \
+                j--; \
+        } \
+        if (i >= j) \
+            break; \
+        name##_swap(i++, --j); \
+    } \
+    return i - a; \
+} \
+ \
+static void name(name##_t *base, size_t nmemb) \
+{ \
+    name##_t *stack[2*8*sizeof(size_t)], **sp = stack; \
+    int depthstack[8*sizeof(size_t)]; \
+    int depth = 0, maxdepth = 0; \
+    name##_t *lo = base, *hi = base + nmemb, *i; \
+ \
+    for (size_t k = nmemb; k > 0; k >>= 1) \
+        maxdepth += 2; \
+    for (;;) { \
+        size_t n = hi - lo; \
+        for (i = lo + 1; i < hi && ! name##_less(i, i - 1); i++) \
+            ; \
+        if (i >= hi) \
+            goto pop; \
+        if (n < QS22T_INSORTTHRESH) { \
+            name##_insertion_sort(lo, hi); \
+            goto pop; \
+        } \
+        if (depth++ >= maxdepth) { \
+            name##_heapsort(lo, n); \
+            goto pop; \
+        } \
+        name##_t *p = lo + n / 2, *right = hi - 1; \
+        if (n >= QS22T_MIDTHRESH) { \
+            name##_t *pleft = lo + 1, *pright = right - 1; \
+            if (n >= QS22T_MEDOF3THRESH) { \
+                size_t k = n / 8; \
+                pleft = name##_med3(pleft, lo + k, lo + k * 2); \
+                p = name##_med3(p - k, p, p + k); \
+                pright = name##_med3(right - k * 2, right - k, pright); \
+            } \
+            p = name##_med3(pleft, p, pright); \
+        } \
+        if (p != right) \
+            name##_swap(p, right); \
+        int le = lo != base && ! name##_less(lo - 1, right); \
+        size_t k = name##_partition(lo, n - 1, right, le); \
+        name##_t *mid = lo + k; \
+        if (mid != right) \
+            name##_swap(mid, right); \
+        if (le) { \
+            lo = mid + 1; \
+            continue; \
+        } \
+        if (mid - lo > hi - mid) { \
+            if (mid - lo > 1) { \
+                sp[0] = lo; \
+                sp[1] = mid; \
+                depthstack[(sp - stack) / 2] = depth; \
+                sp += 2; \
+            } \
+            lo = mid + 1; \
+        } else { \
+            if (hi - mid > 2) { \
+                sp[0] = mid + 1; \
+                sp[1] = hi; \
+                depthstack[(sp - stack) / 2] = depth; \
+                sp += 2; \
+            } \
+            hi = mid; \
+        } \
+        continue; \
+pop: \
+        if (sp == stack) \
+            break; \
+        sp -= 2; \
+        lo = sp[0]; \
+        hi = sp[1]; \
+        depth = depthstack[(sp - stack) / 2]; \
+    } \
+}
+
+#endif
@@ -0,0 +1,135 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22afsort.c -- MSD radix sort of string pointers, in place: American flag
+// sort (McIlroy, Bostic and McIlroy, "Engineering Radix Sort", Computing
+// Systems, 1993). Each string's bytes are looked at once per level instead
+// of once per compare, so shared prefixes aren't re-scanned over and over.
+//
+// Each bucket (pointers to strings equal up to depth) is split on the byte at
+// depth: count the bytes, then permute the pointers into place by cycle
+// leading, with no scratch array. Strings ending at depth are done. Small
+// buckets go to insertion sort comparing from depth on, and a bucket where
+// all strings have the same byte at depth just moves on to depth + 1.
+//
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qs22.h"
+
+#define INSORTTHRESH    32          // if n < this use insertion sort
+#define STACKINIT       256         // initial stack size, in buckets
+
+typedef struct {
+    char **a;
+    size_t n;
+    size_t depth;
+} bucket;
+
+static void insertion_sort(char **a, size_t n, size_t depth)
+{
+    for (size_t i = 1; i < n; i++) {
+        for (size_t j = i; j && strcmp(a[j - 1] + depth, a[j] + depth) > 0;
+                j--) {
+            char *t = a[j - 1];
+            a[j - 1] = a[j];
+            a[j] = t;
+        }
+    }
+}
+
+void qs22_afsort_str(char **base, size_t nmemb)
+{
+    bucket stack0[STACKINIT], *stack = stack0, *sp = stack;
+    size_t stacksize = STACKINIT;
+    char **a = base;
+    size_t n = nmemb, depth = 0;
+    size_t count[256];
+    char **next[256], **end;
+    size_t i;
+
+    for (i = 1; i < n && strcmp(a[i - 1], a[i]) <= 0; i++)
+        ;
+    if (i >= n)                             // if already in order
+        return;
+    for (;;) {
+        if (n < INSORTTHRESH) {
+            insertion_sort(a, n, depth);
+            goto pop;
+        }
+        memset(count, 0, sizeof count);
+        for (i = 0; i < n; i++)
+            count[(unsigned char)a[i][depth]]++;
+        if (count[(unsigned char)a[0][depth]] == n) {   // one bucket
+            if (! a[0][depth])              // all strings end here
+                goto pop;
+            depth++;
+            continue;
+        }
+        next[0] = a;
+        for (int c = 1; c < 256; c++)
+            next[c] = next[c - 1] + count[c - 1];
+        // Permute: for each bucket in turn, take the string at its next
+        // slot and swap it into the bucket it belongs in, until one that
+        // belongs here turns up.
+        end = a;
+        for (int c = 0; c < 256; c++) {
+            end += count[c];                // end of bucket c
+            while (next[c] < end) {
+                char *s = *next[c];
+                int k;
+                while ((k = (unsigned char)s[depth]) != c) {
+                    char *t = *next[k];
+                    *next[k]++ = s;
+                    s = t;
+                }
+                *next[c]++ = s;
+            }
+        }
+        // next[c] is now the end of bucket c. Stack buckets 1..255 with
+        // more than one string; bucket 0 (strings ending here) is done.
+        for (int c = 1; c < 256; c++) {
+            if (count[c] < 2)
+                continue;
+            if (sp == stack + stacksize) {
+                bucket *t = malloc(2 * stacksize * sizeof *t);
+                if (! t) {                  // out of memory; slow but sure
+                    insertion_sort(next[c] - count[c], count[c], depth + 1);
+                    continue;
+                }
+                memcpy(t, stack, stacksize * sizeof *t);
+                if (stack != stack0)
+                    free(stack);
+                stack = t;
+                sp = stack + stacksize;
+                stacksize *= 2;
+            }
+            sp->a = next[c] - count[c];
+            sp->n = count[c];
+            sp->depth = depth + 1;
+            sp++;
+        }
+pop:
+        if (sp == stack)
+            break;
+        sp--;
+        a = sp->a;
+        n = sp->n;
+        depth = sp->depth;
+    }
+    if (stack != stack0)
+        free(stack);
+}
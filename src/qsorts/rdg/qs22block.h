@@ -0,0 +1,164 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22block.h -- block partition of a subfile, for the qs22 quicksorts that
+// use it on big subfiles of small elements (qs22j, qs22pdq).
+//
+#ifndef QS22BLOCK_H
+#define QS22BLOCK_H
+
+#include <stddef.h>
+
+#include "swap.h"
+
+#define QS22BLOCK_SIZE  64          // elements per block; <= 256
+
+#define QS22BLOCK_SWAP(a, b) do {\
+        if (fixed) swap_elems(a, b, size); else swapf(a, b, size);\
+    } while (0)
+#define QS22BLOCK_COMP(a, b) ((*compar)((void *)(a), (void *)(b)))
+#define QS22BLOCK_MIN(a, b) (((a) < (b)) ? (a) : (b))
+
+// Block partition, from Edelkamp and Weiss, "BlockQuicksort: Avoiding Branch
+// Mispredictions in Quicksort" (2016). Elements are compared a block at a
+// time from each end, and the offsets of those on the wrong side are stored
+// without branching on the compare results. Then pairs of misplaced
+// elements are swapped in a loop that depends only on the counts.
+//
+// Partitions [left, limit) around the element at p, and returns the final
+// position of the pivot. Elements equal to the pivot all go to its right, so
+// a right part that is full of duplicates starts with an element equal to its
+// own pivot, and then the caller's fat partition can take over.
+//
+// fixed is nonzero if size is a constant the compiler can inline swap_elems()
+// for; else the swaps call swapf.
+static inline __attribute__((always_inline)) char *qs22block_partition(
+        char *left, char *limit, char *p, size_t size,
+        int (*compar)(const void *, const void *),
+        void (*swapf)(void *, void *, size_t), int fixed)
+{
+    unsigned char offl[QS22BLOCK_SIZE], offr[QS22BLOCK_SIZE];
+    char *begin = left, *last = limit - size, *pv = last;
+    int numl = 0, numr = 0, startl = 0, startr = 0, num, k;
+    ptrdiff_t shiftl, shiftr;
+
+    if (p != pv) {                          // move pivot out of the way
+        QS22BLOCK_SWAP(p, pv);
+    }
+    last -= size;
+    while (last - begin >= (ptrdiff_t)(2 * QS22BLOCK_SIZE * size)) {
+        if (numl == 0) {
+            startl = 0;
+            for (k = 0; k < QS22BLOCK_SIZE; k++) {
+                offl[numl] = k;
+                numl += QS22BLOCK_COMP(begin + k * size, pv) >= 0;
+            }
+        }
+        if (numr == 0) {
+            startr = 0;
+            for (k = 0; k < QS22BLOCK_SIZE; k++) {
+                offr[numr] = k;
+                numr += QS22BLOCK_COMP(last - k * size, pv) < 0;
+            }
+        }
+        num = QS22BLOCK_MIN(numl, numr);
+        for (k = 0; k < num; k++)
+            QS22BLOCK_SWAP(begin + offl[startl + k] * size,
+                    last - offr[startr + k] * size);
+        numl -= num;
+        numr -= num;
+        startl += num;
+        startr += num;
+        if (numl == 0)
+            begin += QS22BLOCK_SIZE * size;
+        if (numr == 0)
+            last -= QS22BLOCK_SIZE * size;
+    }
+
+    // At most 2 blocks are left unscanned, less any block still partly
+    // unswapped. Scan what's left into whichever buffers are empty.
+    ptrdiff_t rest = (last - begin) / (ptrdiff_t)size + 1;
+    if (numl == 0 && numr == 0) {
+        shiftl = rest / 2;
+        shiftr = rest - shiftl;
+        startl = startr = 0;
+        for (k = 0; k < shiftl; k++) {
+            offl[numl] = k;
+            numl += QS22BLOCK_COMP(begin + k * size, pv) >= 0;
+            offr[numr] = k;
+            numr += QS22BLOCK_COMP(last - k * size, pv) < 0;
+        }
+        if (shiftl < shiftr) {
+            offr[numr] = k;
+            numr += QS22BLOCK_COMP(last - k * size, pv) < 0;
+        }
+    } else if (numr != 0) {
+        shiftl = rest - QS22BLOCK_SIZE;
+        shiftr = QS22BLOCK_SIZE;
+        startl = 0;
+        for (k = 0; k < shiftl; k++) {
+            offl[numl] = k;
+            numl += QS22BLOCK_COMP(begin + k * size, pv) >= 0;
+        }
+    } else {
+        shiftl = QS22BLOCK_SIZE;
+        shiftr = rest - QS22BLOCK_SIZE;
+        startr = 0;
+        for (k = 0; k < shiftr; k++) {
+            offr[numr] = k;
+            numr += QS22BLOCK_COMP(last - k * size, pv) < 0;
+        }
+    }
+    num = QS22BLOCK_MIN(numl, numr);
+    for (k = 0; k < num; k++)
+        QS22BLOCK_SWAP(begin + offl[startl + k] * size,
+                last - offr[startr + k] * size);
+    numl -= num;
+    numr -= num;
+    startl += num;
+    startr += num;
+    if (numl == 0)
+        begin += shiftl * size;
+    if (numr == 0)
+        last -= shiftr * size;
+
+    // Now at most one buffer has misplaced elements. Move them to the inner
+    // end of their block, and put the pivot between the parts.
+    if (numl != 0) {
+        ptrdiff_t upper = (last - begin) / (ptrdiff_t)size;
+        for (k = startl + numl - 1; k >= startl && offl[k] == upper; k--)
+            upper--;
+        for ( ; k >= startl; k--, upper--)
+            QS22BLOCK_SWAP(begin + upper * size, begin + offl[k] * size);
+        begin += (upper + 1) * size;
+    } else if (numr != 0) {
+        ptrdiff_t upper = (last - begin) / (ptrdiff_t)size;
+        for (k = startr + numr - 1; k >= startr && offr[k] == upper; k--)
+            upper--;
+        for ( ; k >= startr; k--, upper--)
+            QS22BLOCK_SWAP(last - upper * size, last - offr[k] * size);
+        begin = last - upper * size;
+    }
+    if (begin != pv) {
+        QS22BLOCK_SWAP(begin, pv);
+    }
+    return begin;
+}
+
+#undef QS22BLOCK_SWAP
+#undef QS22BLOCK_COMP
+#undef QS22BLOCK_MIN
+
+#endif
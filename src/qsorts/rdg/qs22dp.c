@@ -0,0 +1,283 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22dp.c -- dual-pivot quicksort (Yaroslavskiy), after Java 7's
+// DualPivotQuicksort, built the way qs22j is. qs22ydpq.c is the plain port.
+//
+// Five elements spread about the middle of each subfile are sorted, and the
+// second and fourth become the pivots p1 < p2. The subfile is split into
+// < p1, p1..p2, and > p2; if the middle part is most of the subfile, the
+// elements equal to p1 or p2 are moved out of it first. If p1 == p2 there
+// are likely many of them, so the subfile is split three ways around that
+// one pivot instead, with Bentley and McIlroy's fat partition.
+//
+// As in qs22j: each subfile is checked for being in order, small ones get
+// insertion sort, partitioning too deep goes to heapsort (introsort), the
+// swaps are those of swap.h, compiled inline for the common element sizes,
+// and there is no recursion.
+//
+#include <stddef.h>
+#include <stdint.h>
+
+#include "qs22heap.h"
+#include "swap.h"
+
+#define INSORTTHRESH    16          // if n < this use insertion sort
+                                    // MUST be >= 16, for the sample
+#define HOLEMAXSIZE     256         // insertion sort moves smaller elements
+                                    // through a hole, not by swaps
+
+#ifndef FIXED_SIZES
+#define FIXED_SIZES     1
+#endif
+
+#define min(a,b) (((a) < (b)) ? (a) : (b))
+
+#define SWAP(a, b) do {\
+        if (fixed) swap_elems(a, b, size); else swap_func(a, b, size);\
+    } while (0)
+
+#define  COMP(a, b)  ((*compar)((void *)(a), (void *)(b)))
+
+#define INLINE inline __attribute__((always_inline))
+
+// Stack a subfile of more than one element.
+#define PUSH(lo, hi) do {\
+        if ((hi) - (lo) > (ptrdiff_t)size) {\
+            sp[0] = (lo);\
+            sp[1] = (hi);\
+            depthstack[(sp - stack) / 2] = depth;\
+            sp += 2;\
+        }\
+    } while (0)
+
+static INLINE void qs22dp_sort(void *base, size_t nmemb, size_t size,
+        int (*compar)(const void *, const void *), int fixed)
+{
+    // Each pass stacks at most two subfiles and goes on with the smallest,
+    // which is at most a third of the one split.
+    char *stack[4*8*sizeof(size_t)], **sp = stack;
+    int depthstack[2*8*sizeof(size_t)];
+    int depth = 0, maxdepth = 0;
+    char *left = base;
+    char *limit = left + nmemb * size;
+    char *i, *j, *k;
+
+    for (size_t n = nmemb; n > 0; n >>= 1)
+        maxdepth += 2;
+    for (;;) {
+        nmemb = (limit - left) / size;
+        for (i = left + size; i < limit && COMP(i - size, i) <= 0; i += size)
+            ;
+        if (i == limit)                     // if already in order
+            goto pop;
+        if (nmemb < INSORTTHRESH) {
+            if (size <= HOLEMAXSIZE) {
+                union { char c[HOLEMAXSIZE]; swap_align_t a; } holebuf;
+                char *hole = holebuf.c;     // aligned for compar
+                for (i = left + size; i < limit; i += size) {
+                    if (COMP(i - size, i) <= 0)
+                        continue;
+                    swap_copy(hole, i, size);
+                    for (j = i - size; j != left && COMP(j - size, hole) > 0; )
+                        j -= size;
+                    swap_move(j + size, j, i - j);
+                    swap_copy(j, hole, size);
+                }
+            } else {
+                for (i = left + size; i < limit; i += size)
+                    for (j = i; j != left && COMP(j - size, j) > 0; j -= size)
+                        SWAP(j - size, j);
+            }
+            goto pop;
+        }
+        if (depth++ >= maxdepth) {          // too deep; use heapsort
+            qs22heapsort(left, nmemb, size, compar, swap_func);
+            goto pop;
+        }
+        char *right = limit - size;
+
+        // Sort five elements about a seventh apart around the middle.
+        size_t seventh = (nmemb / 8 + nmemb / 64 + 1) * size;
+        char *e[5];
+        e[2] = left + (nmemb / 2) * size;
+        e[1] = e[2] - seventh;
+        e[0] = e[1] - seventh;
+        e[3] = e[2] + seventh;
+        e[4] = e[3] + seventh;
+        for (int m = 1; m < 5; m++)
+            for (int n = m; n > 0 && COMP(e[n - 1], e[n]) > 0; n--)
+                SWAP(e[n - 1], e[n]);
+
+        if (COMP(e[1], e[3]) != 0) {
+            // Dual pivot: p1 to the left end, p2 to the right, and then
+            // a[left+1 .. less) < p1 <= a[less .. k) <= p2 < a(great .. right).
+            char *lo[3], *hi[3];
+            int s = 0;
+            SWAP(e[1], left);
+            SWAP(e[3], right);
+            char *less = left + size, *great = right - size;
+            while (COMP(less, left) < 0)
+                less += size;
+            while (COMP(great, right) > 0)
+                great -= size;
+            for (k = less; k <= great; k += size) {
+                if (COMP(k, left) < 0) {
+                    if (k != less)
+                        SWAP(k, less);
+                    less += size;
+                } else if (COMP(k, right) > 0) {
+                    while (COMP(great, right) > 0) {
+                        if (great == k) {
+                            great -= size;
+                            goto split;
+                        }
+                        great -= size;
+                    }
+                    SWAP(k, great);
+                    great -= size;
+                    if (COMP(k, left) < 0) {
+                        SWAP(k, less);
+                        less += size;
+                    }
+                }
+            }
+split:
+            // Pivots into place, between the parts.
+            i = less - size;
+            j = great + size;
+            if (i != left)
+                SWAP(left, i);
+            if (j != right)
+                SWAP(right, j);
+            // If the middle part is most of the subfile, move the elements
+            // equal to p1 (now at i) or p2 (at j) out of it.
+            if (less < e[0] && e[4] < great) {
+                while (COMP(less, i) == 0)
+                    less += size;
+                while (COMP(great, j) == 0)
+                    great -= size;
+                for (k = less; k <= great; k += size) {
+                    if (COMP(k, i) == 0) {
+                        if (k != less)
+                            SWAP(k, less);
+                        less += size;
+                    } else if (COMP(k, j) == 0) {
+                        while (COMP(great, j) == 0) {
+                            if (great == k) {
+                                great -= size;
+                                goto gathered;
+                            }
+                            great -= size;
+                        }
+                        SWAP(k, great);
+                        great -= size;
+                        if (COMP(k, i) == 0) {
+                            SWAP(k, less);
+                            less += size;
+                        }
+                    }
+                }
+            }
+gathered:
+            // Go on with the smallest of the three parts.
+            lo[0] = left;
+            hi[0] = i;
+            lo[1] = less;
+            hi[1] = great + size;
+            lo[2] = j + size;
+            hi[2] = limit;
+            for (int m = 1; m < 3; m++)
+                if (hi[m] - lo[m] < hi[s] - lo[s])
+                    s = m;
+            for (int m = 0; m < 3; m++)
+                if (m != s)
+                    PUSH(lo[m], hi[m]);
+            left = lo[s];
+            limit = hi[s];
+        } else {
+            // One pivot, p1 == p2: fat partition around it, with the
+            // elements equal to it gathered at the ends, then moved to
+            // the middle.
+            SWAP(e[2], left);
+            char *pa, *pb, *pc, *pd;
+            int r;
+            pa = pb = left + size;
+            pc = pd = right;
+            for (;;) {
+                while (pb <= pc && (r = COMP(pb, left)) <= 0) {
+                    if (r == 0) {
+                        SWAP(pa, pb);
+                        pa += size;
+                    }
+                    pb += size;
+                }
+                while (pb <= pc && (r = COMP(pc, left)) >= 0) {
+                    if (r == 0) {
+                        SWAP(pc, pd);
+                        pd -= size;
+                    }
+                    pc -= size;
+                }
+                if (pb > pc)
+                    break;
+                SWAP(pb, pc);
+                pb += size;
+                pc -= size;
+            }
+            ptrdiff_t lessthan = pb - pa, morethan = pd - pc;
+            size_t t = min(pa - left, lessthan);
+            if (t)
+                swap_func(left, pb - t, t);
+            t = min(morethan, right - pd);
+            if (t)
+                swap_func(pb, limit - t, t);
+            if (lessthan > morethan) {
+                PUSH(left, left + lessthan);
+                left = limit - morethan;
+            } else {
+                PUSH(limit - morethan, limit);
+                limit = left + lessthan;
+            }
+        }
+        if (limit - left > (ptrdiff_t)size)
+            continue;
+pop:
+        if (sp == stack)
+            break;
+        sp -= 2;
+        left = sp[0];
+        limit = sp[1];
+        depth = depthstack[(sp - stack) / 2];
+    }
+}
+
+void qsort(void *base, size_t nmemb, size_t size,
+                                     int (*compar)(const void *, const void *))
+{
+#if FIXED_SIZES
+#define FIXEDSIZE(n) case n: qs22dp_sort(base, nmemb, n, compar, 1); return;
+    switch (size) {
+        FIXEDSIZE(4)
+        FIXEDSIZE(8)
+        FIXEDSIZE(12)
+        FIXEDSIZE(16)
+        FIXEDSIZE(24)
+        FIXEDSIZE(32)
+    }
+#undef FIXEDSIZE
+#endif
+    qs22dp_sort(base, nmemb, size, compar, 0);
+}
@@ -0,0 +1,101 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22heap.h -- heapsort of a subfile, for the qs22 quicksorts to fall back on
+// when partitioning goes too deep (introsort). It takes the caller's swap
+// function so the swaps are as fast (and are counted) as in the quicksort
+// that calls it.
+//
+// It is bottom-up heapsort (Wegener, "Bottom-Up-Heapsort", TCS 1993): the
+// element being sifted down nearly always belongs near the bottom, so
+// instead of comparing it with the larger child at each level (two compares
+// a level, as in qs22heap2), go down the larger children to a leaf with one
+// compare a level, then back up to where it belongs, usually a level or two.
+// That is about n lg n compares in all, against 2n lg n. The elements on the
+// path are then moved up a level each, through a hole for elements of up to
+// QS22HEAP_HOLEMAX bytes, else by swaps.
+//
+// qs22heap_sort() is the same, always inline, for a caller that has a
+// constant size (qs22heapbu).
+//
+#ifndef QS22HEAP_H
+#define QS22HEAP_H
+
+#include <stddef.h>
+
+#include "swap.h"
+
+#define QS22HEAP_HOLEMAX    256
+
+#define heapelt(i) (base + ((i) - 1) * size)    // 1-based heap index
+
+// Sift the element at i down into the heap base[1..n].
+static inline __attribute__((always_inline)) void qs22heap_sift(size_t i,
+        size_t n, char *base, size_t size,
+        int (*compar)(const void *, const void *),
+        void (*swapf)(void *, void *, size_t))
+{
+    size_t j = i;
+    int d = 0;
+
+    while (2 * j <= n) {                // down the larger children to a leaf
+        j *= 2;
+        if (j < n && compar(heapelt(j), heapelt(j + 1)) < 0)
+            j++;
+        d++;
+    }
+    while (d && compar(heapelt(i), heapelt(j)) > 0) {   // back up
+        j /= 2;
+        d--;
+    }
+    if (d == 0)
+        return;
+    // The ancestors of j below i are j >> (d - 1), ..., j >> 1, j.
+    if (size <= QS22HEAP_HOLEMAX) {
+        char hole[QS22HEAP_HOLEMAX];
+        swap_copy(hole, heapelt(i), size);
+        while (d--)
+            swap_copy(heapelt(j >> (d + 1)), heapelt(j >> d), size);
+        swap_copy(heapelt(j), hole, size);
+    } else {
+        while (d--)
+            swapf(heapelt(j >> (d + 1)), heapelt(j >> d), size);
+    }
+}
+
+static inline __attribute__((always_inline)) void qs22heap_sort(char *base,
+        size_t n, size_t size, int (*compar)(const void *, const void *),
+        void (*swapf)(void *, void *, size_t))
+{
+    size_t i;
+    for (i = n / 2; i >= 1; i--)
+        qs22heap_sift(i, n, base, size, compar, swapf);
+    for (i = n; i >= 2; i--) {
+        swapf(heapelt(1), heapelt(i), size);
+        qs22heap_sift(1, i - 1, base, size, compar, swapf);
+    }
+}
+
+#undef heapelt
+
+__attribute__((unused))
+static void qs22heapsort(char *base, size_t n, size_t size,
+        int (*compar)(const void *, const void *),
+        void (*swapf)(void *, void *, size_t))
+{
+    qs22heap_sort(base, n, size, compar, swapf);
+}
+
+#endif
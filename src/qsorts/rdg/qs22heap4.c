@@ -0,0 +1,105 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22heap4.c -- heapsort on a 4-ary heap. The four children of a node are
+// side by side, so for elements of up to 16 bytes a node's children are in
+// one cache line, or two, where in a binary heap each level below the top
+// few is another line; and there are half as many levels. It sifts down
+// bottom-up, as qs22heap.h does: down the largest children to a leaf (three
+// compares a level, half as many levels: 1.5 lg n), then back up to where
+// the element belongs. Elements of up to HOLEMAXSIZE bytes are moved through
+// a hole, bigger ones by swaps; the common sizes get the moves inline.
+//
+#include <stddef.h>
+
+#include "swap.h"
+
+#define HOLEMAXSIZE     256         // move bigger elements by swaps
+
+#ifndef FIXED_SIZES
+#define FIXED_SIZES     1
+#endif
+
+#define INLINE inline __attribute__((always_inline))
+
+#define  COMP(a, b)  ((*compar)((void *)(a), (void *)(b)))
+
+#define elt(i)  (base + (i) * size)     // children of i are 4i+1 .. 4i+4
+
+// Sift the element at i down into the heap base[0..n).
+static INLINE void sift(size_t i, size_t n, char *base, size_t size,
+        int (*compar)(const void *, const void *))
+{
+    size_t path[8 * sizeof(size_t)];    // i and the nodes below it, to j
+    size_t j = i, c;
+    int d = 0;
+
+    path[0] = i;
+    while ((c = 4 * j + 1) < n) {       // down the largest children
+        size_t e = c + 4 < n ? c + 4 : n;
+        j = c;
+        while (++c < e)
+            if (COMP(elt(j), elt(c)) < 0)
+                j = c;
+        path[++d] = j;
+    }
+    while (d && COMP(elt(i), elt(path[d])) > 0)    // back up
+        d--;
+    if (d == 0)
+        return;
+    if (size <= HOLEMAXSIZE) {
+        char hole[HOLEMAXSIZE];
+        swap_copy(hole, elt(i), size);
+        for (int k = 0; k < d; k++)
+            swap_copy(elt(path[k]), elt(path[k + 1]), size);
+        swap_copy(elt(path[d]), hole, size);
+    } else {
+        for (int k = 0; k < d; k++)
+            swap_func(elt(path[k]), elt(path[k + 1]), size);
+    }
+}
+
+static INLINE void qs22heap4_sort(char *base, size_t n, size_t size,
+        int (*compar)(const void *, const void *))
+{
+    if (n < 2)
+        return;
+    for (size_t i = (n - 2) / 4 + 1; i-- > 0; )
+        sift(i, n, base, size, compar);
+    for (size_t m = n - 1; m > 0; m--) {
+        swap_elems(elt(0), elt(m), size);
+        sift(0, m, base, size, compar);
+    }
+}
+
+#undef elt
+
+void qsort(void *base, size_t nmemb, size_t size,
+                                     int (*compar)(const void *, const void *))
+{
+#if FIXED_SIZES
+#define FIXEDSIZE(n) case n: qs22heap4_sort(base, nmemb, n, compar); return;
+    switch (size) {
+        FIXEDSIZE(4)
+        FIXEDSIZE(8)
+        FIXEDSIZE(12)
+        FIXEDSIZE(16)
+        FIXEDSIZE(24)
+        FIXEDSIZE(32)
+    }
+#undef FIXEDSIZE
+#endif
+    qs22heap4_sort(base, nmemb, size, compar);
+}
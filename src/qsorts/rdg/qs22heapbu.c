@@ -0,0 +1,46 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22heapbu.c -- bottom-up heapsort, the one the qs22 quicksorts fall back
+// on (qs22heap.h), as a qsort(), with the moves inline for the common
+// element sizes.
+//
+#include <stddef.h>
+
+#include "qs22heap.h"
+#include "swap.h"
+
+#ifndef FIXED_SIZES
+#define FIXED_SIZES     1
+#endif
+
+void qsort(void *base, size_t nmemb, size_t size,
+                                     int (*compar)(const void *, const void *))
+{
+#if FIXED_SIZES
+#define FIXEDSIZE(n) case n: qs22heap_sort(base, nmemb, n, compar, swap_func);\
+                             return;
+    switch (size) {
+        FIXEDSIZE(4)
+        FIXEDSIZE(8)
+        FIXEDSIZE(12)
+        FIXEDSIZE(16)
+        FIXEDSIZE(24)
+        FIXEDSIZE(32)
+    }
+#undef FIXEDSIZE
+#endif
+    qs22heap_sort(base, nmemb, size, compar, swap_func);
+}
@@ -0,0 +1,486 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22ism.c -- stable block merge sort in place, for callers that need a
+// stable sort but can't afford the n / 2 elements of scratch that qs22run
+// (or quadsort) asks for. No malloc(); O(1) extra space besides a fixed
+// CACHEBYTES on the stack that only speeds up rotations. It is GrailSort
+// (Andrey Astrelin, 2013), after Huang and Langston, "Fast Stable Merging
+// and Sorting in Constant Extra Space" (Computer Journal, 1992):
+//
+//  - About 2 sqrt(n) distinct keys are collected at the front: each element
+//    is looked up in those found so far, and if new it is rotated in. Each
+//    is the first of its equal elements, so the rest keep their order.
+//  - The second sqrt(n) of them are the merge buffer. A merge through it
+//    swaps each output element with a buffer element rather than copying
+//    it, so the buffer moves along the array, scrambled, and nothing is
+//    lost. Runs of 2 sqrt(n) elements are built by such merges.
+//  - Each later pass merges pairs of runs. The runs are cut into blocks of
+//    sqrt(n), the blocks are selection sorted by first element (the first
+//    sqrt(n) keys tag them, to keep the left run's blocks first among
+//    equals), and then each block is merged through the buffer with the
+//    rest of the one before it, if from the other run.
+//  - Last, the keys and buffer are sorted by insertion and merged into the
+//    rest.
+//
+// That is O(n log n) compares and moves. With fewer distinct keys, fewer
+// keys are used, as tags and as a smaller buffer, or as tags with blocks
+// merged by rotations; with fewer than 4, the sort is a bottom-up merge
+// sort whose merges rotate (qs22merge.h), which on at most 3 distinct
+// values is a few rotations a merge. Rotations are through the cache, or a
+// block swap, or three reversals, as in quadsort's trinity_rotation(); the
+// key searches are monobound binary searches, as in quadsort.
+//
+// Data already in order are found by one pass and left alone. Otherwise,
+// the sort doesn't adapt: nearly ordered data take about as long as random,
+// where qs22run (with its buffer) takes about linear time.
+//
+#include <stddef.h>
+
+#include "qs22merge.h"
+#include "swap.h"
+
+#define MINRUN          16          // insertion sort blocks of this many
+#ifndef CACHEBYTES
+#define CACHEBYTES      2048        // bytes of rotation buffer on the stack
+#endif
+
+#ifndef FIXED_SIZES
+#define FIXED_SIZES     1
+#endif
+
+#define min(a,b) (((a) < (b)) ? (a) : (b))
+
+#define INLINE inline __attribute__((always_inline))
+
+#define COMP(a, b)  ((*compar)((void *)(a), (void *)(b)))
+#define ELT(a, i)   ((a) + (ptrdiff_t)(i) * (ptrdiff_t)size)
+#define SWAP1(a, b) swap_elems(a, b, size)
+
+// Swap a[0..n) and b[0..n) an element at a time from the front; they may
+// overlap, with a before b.
+static INLINE void swapn(char *a, char *b, ptrdiff_t n, size_t size)
+{
+    for (; n > 0; n--, a += size, b += size)
+        SWAP1(a, b);
+}
+
+// Index of the first of a[0..n) not less than key (monobound binary search:
+// the same number of compares whatever the answer).
+static INLINE ptrdiff_t search_left(char *a, ptrdiff_t n, char *key,
+        size_t size, qs22merge_cmp compar)
+{
+    ptrdiff_t lo = 0, top = n;
+
+    if (n == 0)
+        return 0;
+    while (top > 1) {
+        ptrdiff_t mid = top / 2;
+        if (COMP(ELT(a, lo + mid), key) < 0)
+            lo += mid;
+        top -= mid;
+    }
+    return lo + (COMP(ELT(a, lo), key) < 0);
+}
+
+// Index of the first of a[0..n) greater than key.
+static INLINE ptrdiff_t search_right(char *a, ptrdiff_t n, char *key,
+        size_t size, qs22merge_cmp compar)
+{
+    ptrdiff_t lo = 0, top = n;
+
+    if (n == 0)
+        return 0;
+    while (top > 1) {
+        ptrdiff_t mid = top / 2;
+        if (COMP(ELT(a, lo + mid), key) <= 0)
+            lo += mid;
+        top -= mid;
+    }
+    return lo + (COMP(ELT(a, lo), key) <= 0);
+}
+
+// Merge a[0..n1) and a[n1..n1+n2) without the internal buffer.
+static void merge_rot(char *a, ptrdiff_t n1, ptrdiff_t n2,
+        size_t size, qs22merge_cmp compar, qs22merge_buf *s)
+{
+    if (n1 > 0 && n2 > 0)
+        qs22merge(a, n1, n2, size, compar, s);
+}
+
+// Move up to want distinct elements to the front of a[0..n), in order, and
+// return how many there were.
+static ptrdiff_t find_keys(char *a, ptrdiff_t n, ptrdiff_t want,
+        size_t size, qs22merge_cmp compar, qs22merge_buf *s)
+{
+    ptrdiff_t h = 1, h0 = 0, u;             // keys are a[h0..h0+h)
+
+    for (u = 1; u < n && h < want; u++) {
+        ptrdiff_t r = search_left(ELT(a, h0), h, ELT(a, u), size, compar);
+        if (r == h || COMP(ELT(a, u), ELT(a, h0 + r)) != 0) {
+            qs22merge_rotate(ELT(a, h0), h, u - (h0 + h), size, s);
+            h0 = u - h;
+            qs22merge_rotate(ELT(a, h0 + r), h - r, 1, size, s);
+            h++;
+        }
+    }
+    qs22merge_rotate(a, h0, h, size, s);
+    return h;
+}
+
+// Merge a[0..n1) and a[n1..n1+n2) through the buffer a[m..m+n1), m < 0,
+// which ends up after the result.
+static INLINE void merge_left(char *a, ptrdiff_t n1, ptrdiff_t n2,
+        ptrdiff_t m, size_t size, qs22merge_cmp compar)
+{
+    ptrdiff_t p0 = 0, p1 = n1;
+
+    n2 += n1;
+    while (p1 < n2) {
+        if (p0 == n1 || COMP(ELT(a, p0), ELT(a, p1)) > 0)
+            SWAP1(ELT(a, m++), ELT(a, p1++));
+        else
+            SWAP1(ELT(a, m++), ELT(a, p0++));
+    }
+    if (m != p0)
+        swapn(ELT(a, m), ELT(a, p0), n1 - p0, size);
+}
+
+// Merge a[0..n1) and a[n1..n1+n2) through the buffer a[n1+n2..n1+n2+m),
+// backward, which ends up before the result.
+static INLINE void merge_right(char *a, ptrdiff_t n1, ptrdiff_t n2,
+        ptrdiff_t m, size_t size, qs22merge_cmp compar)
+{
+    ptrdiff_t p0 = n1 + n2 + m - 1, p2 = n1 + n2 - 1, p1 = n1 - 1;
+
+    while (p1 >= 0) {
+        if (p2 < n1 || COMP(ELT(a, p1), ELT(a, p2)) > 0)
+            SWAP1(ELT(a, p0--), ELT(a, p1--));
+        else
+            SWAP1(ELT(a, p0--), ELT(a, p2--));
+    }
+    if (p2 != p0)
+        while (p2 >= n1)
+            SWAP1(ELT(a, p0--), ELT(a, p2--));
+}
+
+// Merge the rest of a block, a[0..*n1), with the next block, a[*n1..*n1+n2),
+// through the buffer a[-nbuf..0), until one of them runs out. *type is 0 if
+// the rest came from the left run of the merge, 1 if from the right; of
+// equal elements, those of the left run go first. On return the merged
+// elements start at a[-nbuf], the buffer follows them, and the elements not
+// merged yet end where the block did; *n1 and *type are set for those.
+static INLINE void smart_merge_buf(char *a, ptrdiff_t *n1, int *type,
+        ptrdiff_t n2, ptrdiff_t nbuf, size_t size, qs22merge_cmp compar)
+{
+    ptrdiff_t p0 = -nbuf, p1 = 0, p2 = *n1, q1 = p2, q2 = p2 + n2;
+    int left = *type == 0;                  // left run wins ties
+
+    while (p1 < q1 && p2 < q2) {
+        int c = COMP(ELT(a, p1), ELT(a, p2));
+        if (left ? c <= 0 : c < 0)
+            SWAP1(ELT(a, p0++), ELT(a, p1++));
+        else
+            SWAP1(ELT(a, p0++), ELT(a, p2++));
+    }
+    if (p1 < q1) {
+        *n1 = q1 - p1;
+        while (p1 < q1)
+            SWAP1(ELT(a, --q1), ELT(a, --q2));
+    } else {
+        *n1 = q2 - p2;
+        *type = left;
+    }
+}
+
+// The same without a buffer, by rotations; the merged elements stay at the
+// front.
+static void smart_merge_rot(char *a, ptrdiff_t *n1, int *type,
+        ptrdiff_t n2, size_t size, qs22merge_cmp compar, qs22merge_buf *s)
+{
+    ptrdiff_t len1 = *n1;
+    int left = *type == 0;
+
+    if (n2 == 0)
+        return;
+    if (len1) {
+        int c = COMP(ELT(a, len1 - 1), ELT(a, len1));
+        if (left ? c > 0 : c >= 0) {
+            while (len1) {
+                ptrdiff_t h = left
+                    ? search_left(ELT(a, len1), n2, a, size, compar)
+                    : search_right(ELT(a, len1), n2, a, size, compar);
+                if (h) {
+                    qs22merge_rotate(a, len1, h, size, s);
+                    a = ELT(a, h);
+                    n2 -= h;
+                }
+                if (n2 == 0) {
+                    *n1 = len1;
+                    return;
+                }
+                do {
+                    a += size;
+                    len1--;
+                    c = len1 ? COMP(a, ELT(a, len1)) : 0;
+                } while (len1 && (left ? c <= 0 : c < 0));
+            }
+        }
+    }
+    *n1 = n2;
+    *type = left;
+}
+
+// Merge the nblock blocks of lblock elements at a, in order of first
+// element and tagged by keys[], with each other where they came from
+// different runs (the left run's keys are those less than *midkey), then
+// with the acount blocks and the lastlen elements after them, a partial
+// block from the right run and the left run's blocks that go after it. The
+// buffer, if havebuf, is the lblock elements before a, and ends up after
+// the result.
+static INLINE void merge_blocks(char *keys, char *midkey, char *a,
+        ptrdiff_t nblock, ptrdiff_t lblock, int havebuf, ptrdiff_t acount,
+        ptrdiff_t lastlen, size_t size, qs22merge_cmp compar,
+        qs22merge_buf *s)
+{
+    ptrdiff_t prest, lrest, pidx, cidx;
+    int frest;
+
+    if (nblock == 0) {
+        ptrdiff_t l = acount * lblock;
+        if (havebuf)
+            merge_left(a, l, lastlen, -lblock, size, compar);
+        else
+            merge_rot(a, l, lastlen, size, compar, s);
+        return;
+    }
+    lrest = lblock;
+    frest = COMP(keys, midkey) >= 0;
+    pidx = lblock;
+    for (cidx = 1; cidx < nblock; cidx++, pidx += lblock) {
+        int fnext = COMP(ELT(keys, cidx), midkey) >= 0;
+        prest = pidx - lrest;
+        if (fnext == frest) {
+            if (havebuf)
+                swapn(ELT(a, prest - lblock), ELT(a, prest), lrest, size);
+            lrest = lblock;
+        } else if (havebuf) {
+            smart_merge_buf(ELT(a, prest), &lrest, &frest, lblock, lblock,
+                    size, compar);
+        } else {
+            smart_merge_rot(ELT(a, prest), &lrest, &frest, lblock,
+                    size, compar, s);
+        }
+    }
+    prest = pidx - lrest;
+    if (lastlen) {
+        if (frest) {
+            if (havebuf)
+                swapn(ELT(a, prest - lblock), ELT(a, prest), lrest, size);
+            prest = pidx;
+            lrest = lblock * acount;
+        } else {
+            lrest += lblock * acount;
+        }
+        if (havebuf)
+            merge_left(ELT(a, prest), lrest, lastlen, -lblock, size, compar);
+        else
+            merge_rot(ELT(a, prest), lrest, lastlen, size, compar, s);
+    } else if (havebuf) {
+        swapn(ELT(a, prest - lblock), ELT(a, prest), lrest, size);
+    }
+}
+
+// Sort a[0..n) into runs of 2 * k elements (the last may be shorter) with
+// the buffer of k elements before a, k >= 2 a power of 2. The buffer ends up
+// where it started.
+static INLINE void build_runs(char *a, ptrdiff_t n, ptrdiff_t k,
+        size_t size, qs22merge_cmp compar, qs22merge_buf *s)
+{
+    ptrdiff_t m, h, p0, rest, restk, p;
+
+    for (m = 1; m < n; m += 2) {            // pairs, into the buffer
+        int u = COMP(ELT(a, m - 1), ELT(a, m)) > 0;
+        SWAP1(ELT(a, m - 3), ELT(a, m - 1 + u));
+        SWAP1(ELT(a, m - 2), ELT(a, m - u));
+    }
+    if (n % 2)
+        SWAP1(ELT(a, n - 1), ELT(a, n - 3));
+    a = ELT(a, -2);
+    for (h = 2; h < k; h *= 2) {            // merged leftward
+        for (p0 = 0; p0 <= n - 2 * h; p0 += 2 * h)
+            merge_left(ELT(a, p0), h, h, -h, size, compar);
+        rest = n - p0;
+        if (rest > h)
+            merge_left(ELT(a, p0), h, rest - h, -h, size, compar);
+        else
+            qs22merge_rotate(ELT(a, p0 - h), h, rest, size, s);
+        a = ELT(a, -h);
+    }
+    restk = n % (2 * k);                    // last level merged rightward,
+    p = n - restk;                          // taking the buffer back
+    if (restk <= k)
+        qs22merge_rotate(ELT(a, p), restk, k, size, s);
+    else
+        merge_right(ELT(a, p), k, restk - k, k, size, compar);
+    while (p > 0) {
+        p -= 2 * k;
+        merge_right(ELT(a, p), k, k, k, size, compar);
+    }
+}
+
+// Merge the pairs of runs of ll elements in a[0..n), with blocks of lblock
+// elements tagged by keys[], through the buffer of lblock elements before a
+// if havebuf, else by rotations.
+static INLINE void combine_runs(char *keys, char *a, ptrdiff_t n,
+        ptrdiff_t ll, ptrdiff_t lblock, int havebuf, size_t size,
+        qs22merge_cmp compar, qs22merge_buf *s)
+{
+    ptrdiff_t npairs = n / (2 * ll), lrest = n % (2 * ll), b;
+
+    if (lrest <= ll) {                      // a lone last run is done
+        n -= lrest;
+        lrest = 0;
+    }
+    for (b = 0; b <= npairs; b++) {
+        if (b == npairs && lrest == 0)
+            break;
+        char *a1 = ELT(a, b * 2 * ll);
+        ptrdiff_t nblk = (b == npairs ? lrest : 2 * ll) / lblock;
+        ptrdiff_t midkey = ll / lblock, u, v, nbl2 = 0, llast = 0;
+        qs22merge_bininsert(keys, 1, nblk + (b == npairs), size, compar);
+        for (u = 1; u < nblk; u++) {        // selection sort the blocks
+            ptrdiff_t p = u - 1;
+            for (v = u; v < nblk; v++) {
+                int c = COMP(ELT(a1, p * lblock), ELT(a1, v * lblock));
+                if (c > 0 || (c == 0 && COMP(ELT(keys, p), ELT(keys, v)) > 0))
+                    p = v;
+            }
+            if (p != u - 1) {
+                swap_func(ELT(a1, (u - 1) * lblock), ELT(a1, p * lblock),
+                        lblock * size);
+                SWAP1(ELT(keys, u - 1), ELT(keys, p));
+                if (midkey == u - 1 || midkey == p)
+                    midkey ^= (u - 1) ^ p;
+            }
+        }
+        if (b == npairs)
+            llast = lrest % lblock;
+        if (llast != 0)
+            while (nbl2 < nblk && COMP(ELT(a1, nblk * lblock),
+                        ELT(a1, (nblk - nbl2 - 1) * lblock)) < 0)
+                nbl2++;
+        merge_blocks(keys, ELT(keys, midkey), a1, nblk - nbl2, lblock,
+                havebuf, nbl2, llast, size, compar, s);
+    }
+    if (havebuf)                            // move the buffer back
+        while (--n >= 0)
+            SWAP1(ELT(a, n), ELT(a, n - lblock));
+}
+
+// Bottom-up merge sort whose merges rotate when the cache is too small, for
+// arrays with fewer than 4 distinct keys.
+static void rotation_sort(char *a, size_t n, size_t size,
+        qs22merge_cmp compar, qs22merge_buf *s)
+{
+    size_t lo, w;
+
+    for (lo = 0; lo < n; lo += MINRUN)
+        qs22merge_bininsert(a + lo * size, 1, min(MINRUN, n - lo), size,
+                compar);
+    for (w = MINRUN; w < n; w *= 2)
+        for (lo = 0; lo + w < n; lo += 2 * w)
+            qs22merge(a + lo * size, w, min(w, n - lo - w), size, compar, s);
+}
+
+static INLINE void qs22ism_sort(char *base, size_t nmemb, size_t size,
+        qs22merge_cmp compar)
+{
+    union { char c[CACHEBYTES]; swap_align_t a; } cache;
+    qs22merge_buf s;
+    ptrdiff_t n = nmemb, lblock, nkeys, found, ptr, cbuf;
+    int havebuf = 1;
+
+    s.buf = cache.c;
+    s.cap = CACHEBYTES / size;
+    if (nmemb <= MINRUN) {
+        qs22merge_bininsert(base, 1, nmemb, size, compar);
+        return;
+    }
+    for (ptr = 1; ptr < n && COMP(ELT(base, ptr - 1), ELT(base, ptr)) <= 0;
+            ptr++)
+        ;
+    if (ptr == n)                           // in order already
+        return;
+    for (lblock = 1; lblock * lblock < n; lblock *= 2)
+        ;
+    nkeys = (n - 1) / lblock + 1;           // a tag for each block
+    found = find_keys(base, n, nkeys + lblock, size, compar, &s);
+    if (found < nkeys + lblock) {
+        if (found < 4) {
+            rotation_sort(base, nmemb, size, compar, &s);
+            return;
+        }
+        for (nkeys = lblock; nkeys > found; nkeys /= 2)
+            ;
+        havebuf = 0;
+        lblock = 0;
+    }
+    ptr = lblock + nkeys;
+    cbuf = havebuf ? lblock : nkeys;        // without a buffer, the keys
+    build_runs(ELT(base, ptr), n - ptr, cbuf, size, compar, &s);
+    while (n - ptr > (cbuf *= 2)) {         // runs of cbuf are built
+        ptrdiff_t lb = lblock;
+        int chavebuf = havebuf;
+        if (! havebuf) {
+            if (nkeys > 4 && nkeys / 8 * nkeys >= cbuf) {
+                lb = nkeys / 2;             // half the keys as buffer
+                chavebuf = 1;
+            } else {                        // blocks as many as the keys
+                ptrdiff_t nk = 1;
+                unsigned long long t = (unsigned long long)cbuf * found / 2;
+                while (nk < nkeys && t != 0) {
+                    nk *= 2;
+                    t /= 8;
+                }
+                lb = (2 * cbuf) / nk;
+            }
+        }
+        combine_runs(base, ELT(base, ptr), n - ptr, cbuf, lb, chavebuf,
+                size, compar, &s);
+    }
+    qs22merge_bininsert(base, 1, ptr, size, compar);
+    merge_rot(base, ptr, n - ptr, size, compar, &s);
+}
+
+void qsort(void *base, size_t nmemb, size_t size,
+                                     int (*compar)(const void *, const void *))
+{
+    if (size == 0)
+        return;
+#if FIXED_SIZES
+#define FIXEDSIZE(n) case n: qs22ism_sort(base, nmemb, n, compar); return;
+    switch (size) {
+        FIXEDSIZE(4)
+        FIXEDSIZE(8)
+        FIXEDSIZE(12)
+        FIXEDSIZE(16)
+        FIXEDSIZE(24)
+        FIXEDSIZE(32)
+    }
+#undef FIXEDSIZE
+#endif
+    qs22ism_sort(base, nmemb, size, compar);
+}
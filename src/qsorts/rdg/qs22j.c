@@ -18,6 +18,12 @@ extern unsigned long long tot_swaps;
 #endif
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
+
+#include "qs22.h"
+#include "qs22block.h"
+#include "qs22heap.h"
+#include "swap.h"
 
 #define INSORTTHRESH    5           // if n < this use insertion sort
                                     // MUST be >= 2
@@ -25,10 +31,54 @@ extern unsigned long long tot_swaps;
 #define MEDOF3THRESH    50          // < this use median-of-3 as pivot
                                     // larger subfiles use med-of-3-medians
 
+// Block partitioning (see qs22block.h) is used on subfiles of at least
+// BLOCKTHRESH elements of at most BLOCKMAXSIZE bytes.
+#ifndef BLOCK_PARTITION
+#define BLOCK_PARTITION 1
+#endif
+#define BLOCKTHRESH     256
+#define BLOCKMAXSIZE    16
+
+// Indirect mode (see indirect_sort()) is used on subfiles of INDIRECTTHRESH
+// to INDIRECTMAXBYTES / size elements of at least INDIRECTSIZE bytes.
+#ifndef INDIRECT
+#define INDIRECT        1
+#endif
+#define INDIRECTSIZE    64
+#define INDIRECTTHRESH  32
+#ifndef INDIRECTMAXBYTES
+#define INDIRECTMAXBYTES (1024 * 1024)
+#endif
+
+// Subfiles of at least SAMPLETHRESH elements take as pivot the median of a
+// sample of about sqrt(n) of them, between sqrt(n) / 2 and sqrt(n), which is
+// sorted in place at the front of the subfile. Smaller subfiles use the
+// middle element, med3 or the ninther, as their size calls for.
+#ifndef SAMPLE_PIVOT
+#define SAMPLE_PIVOT    1
+#endif
+#define SAMPLETHRESH    (1 << 12)
+
+// Insertion sort on elements of at most HOLEMAXSIZE bytes copies an element
+// that goes back more than one place out to a stack temp, moves the ones
+// ahead of it up in one memmove(), and copies it into the hole left, rather
+// than swapping it back a place at a time. It is off by default: below
+// INSORTTHRESH an element goes back at most 3 places, where it saves no time
+// and moves slightly more bytes than the swaps do.
+#ifndef HOLE_INSERTION
+#define HOLE_INSERTION  0
+#endif
+#define HOLEMAXSIZE     256
+
+// The sort is compiled once for each of the element sizes 4, 8, 12, 16, 24
+// and 32 bytes, with swaps inlined for that size, and once for other sizes;
+// qsort() picks the copy to run (see qs22j_sort()).
+#ifndef FIXED_SIZES
+#define FIXED_SIZES     1
+#endif
+
 #define min(a,b) (((a) < (b)) ? (a) : (b))
 
-typedef int32_t WORD;
-typedef int64_t DWORD;
 typedef void *pref_typ;
 
 // if no uintptr_t, use Bentley-McIlroy trick (undefined behavior)
@@ -38,76 +88,108 @@ typedef void *pref_typ;
 #define ASWAP(a, b, t) ((void)(t = a, a = b, b = t))
 
 #if COUNTSWAPS
-#define SWAP(a, b) if (swap_type) swapf(a, b, size);\
+#define SWAP(a, b) if (fixed) swap_elems(a, b, size);\
+    else if (swap_type) swapf(a, b, size);\
     else do {tot_swaps += sizeof(pref_typ);\
             pref_typ t; ASWAP(*(pref_typ*)(a), *(pref_typ*)(b), t);} while (0)
 #else
-#define SWAP(a, b) if (swap_type) swapf(a, b, size);\
+#define SWAP(a, b) if (fixed) swap_elems(a, b, size);\
+    else if (swap_type) swapf(a, b, size);\
     else do {pref_typ t; ASWAP(*(pref_typ*)(a), *(pref_typ*)(b), t);} while (0)
 #endif
 
 #define  COMP(a, b)  ((*compar)((void *)(a), (void *)(b)))
 
-static void swapbytes(void *a0, void *b0, size_t n)
-{
 #if COUNTSWAPS
-    tot_swaps += n;
+// Partition balance, for test_sorts: partitions made, elements in them, and
+// elements in the smaller side of each (ideally half), and the deepest
+// partition. The caller zeroes them.
+extern unsigned long long qs22_parts, qs22_part_elems, qs22_part_smaller;
+extern int qs22_part_depth;
 #endif
-    char *a = a0, *b = b0, t;
-    do {ASWAP(*a, *b, t); a++; b++;} while (--n);
-}
 
-static void swapdword(void *a0, void *b0, size_t n)
-{
-#if COUNTSWAPS
-    tot_swaps += sizeof(DWORD);
-#endif
-    DWORD *a = a0, *b = b0, t;
-    ASWAP(*a, *b, t);
-    (void)n;
-}
+typedef void (*swapf_typ)(void *, void *, size_t);
 
-static void swapdwords(void *a0, void *b0, size_t n)
+#define INLINE inline __attribute__((always_inline))
+
+static char *med3(char *a, char *b, char *c, int (*compar)(const void *, const void *))
 {
-#if COUNTSWAPS
-    tot_swaps += n;
-#endif
-    DWORD *a = a0, *b = b0, t;
-    do {ASWAP(*a, *b, t); a++; b++;} while (n -= sizeof(DWORD));
+    return COMP(a, b) < 0 ?
+        (COMP(b, c) < 0 ? b : COMP(a, c) < 0 ? c : a) :
+        (COMP(b, c) > 0 ? b : COMP(a, c) > 0 ? c : a);
 }
 
-static void swapword(void *a0, void *b0, size_t n)
-{
-#if COUNTSWAPS
-    tot_swaps += sizeof(WORD);
+// For indirect_sort() and the pivot sample, which sort with qsort().
+void qsort(void *base, size_t nmemb, size_t size,
+                                     int (*compar)(const void *, const void *));
+
+#if INDIRECT
+// The caller's compare function, for indirect_compare(). Saved and restored
+// around each indirect sort, so a compare function may itself call qsort().
+// It is thread-local where the compiler has a way to say so; without one,
+// qs22j is not thread-safe on elements of INDIRECTSIZE bytes or more.
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define THREAD_LOCAL    _Thread_local
+#elif defined(__GNUC__)
+#define THREAD_LOCAL    __thread
+#elif defined(_MSC_VER)
+#define THREAD_LOCAL    __declspec(thread)
+#else
+#define THREAD_LOCAL
 #endif
-    WORD *a = a0, *b = b0, t;
-    ASWAP(*a, *b, t);
-    (void)n;
-}
+static THREAD_LOCAL int (*indirect_compar)(const void *, const void *);
 
-static void swapwords(void *a0, void *b0, size_t n)
+static int indirect_compare(const void *a, const void *b)
 {
-#if COUNTSWAPS
-    tot_swaps += n;
-#endif
-    WORD *a = a0, *b = b0, t;
-    do {ASWAP(*a, *b, t); a++; b++;} while (n -= sizeof(WORD));
+    return indirect_compar(*(char **)a, *(char **)b);
 }
 
-typedef void (*swapf_typ)(void *, void *, size_t);
-
-static char *med3(char *a, char *b, char *c, int (*compar)(const void *, const void *))
+// Indirect sort, for big elements: sort an array of pointers to them, then
+// put the elements in place by following the cycles of the permutation. The
+// first element of each cycle is copied out to tmp, the element that belongs
+// in its place is moved in, and so on round the cycle to the slot that tmp
+// goes in. Each element is moved at most once, where the direct sort would
+// swap it about lg(n) times. But the pointer sort and the moves jump about
+// the array, so this is only done on subfiles that fit in cache; bigger ones
+// are partitioned directly until they do.
+static void indirect_sort(char *base, size_t nmemb, size_t size,
+        int (*compar)(const void *, const void *), char **ptrs, char *tmp)
 {
-    return COMP(a, b) < 0 ?
-        (COMP(b, c) < 0 ? b : COMP(a, c) < 0 ? c : a) :
-        (COMP(b, c) > 0 ? b : COMP(a, c) > 0 ? c : a);
+    int (*save_compar)(const void *, const void *) = indirect_compar;
+    size_t k, j, i;
+
+    for (k = 0; k < nmemb; k++)
+        ptrs[k] = base + k * size;
+    indirect_compar = compar;
+    qsort(ptrs, nmemb, sizeof *ptrs, indirect_compare);
+    indirect_compar = save_compar;
+    for (k = 0; k < nmemb; k++) {
+        if (ptrs[k] == base + k * size)     // in place, or cycle done
+            continue;
+        swap_copy(tmp, base + k * size, size);
+        for (j = k; (i = (ptrs[j] - base) / size) != k; j = i) {
+            swap_copy(base + j * size, ptrs[j], size);
+            ptrs[j] = base + j * size;
+        }
+        swap_copy(base + j * size, tmp, size);
+        ptrs[j] = base + j * size;
+    }
 }
+#endif
 
-void qsort(void *base, size_t nmemb, size_t size,
-                                     int (*compar)(const void *, const void *))
+// The sort proper. It is inlined into qs22j_run() once for each fixed size
+// with fixed set, where the compiler can make each SWAP a few moves of that
+// size, and once with fixed clear for any size, where the SWAPs call the swap
+// function chosen below. With sh not NULL, it sorts one piece of a bigger
+// sort, and hands big parts to sh->share() rather than stacking them (see
+// qs22j_sub() in qs22.h).
+static INLINE void qs22j_sort(void *base, size_t nmemb, size_t size,
+        int (*compar)(const void *, const void *), int fixed, qs22j_share *sh)
 {
     char *stack[2*8*sizeof(size_t)], **sp = stack; // stack and stack pointer
+    int depthstack[8*sizeof(size_t)];       // depth of each stacked subfile
+    int depth = 0, maxdepth = 0;            // partitioning depth and limit
+    size_t minshare = sh ? sh->minshare * size : (size_t)-1;
     char *left = base;                      // set up char * base pointer
     char *limit = left + nmemb * size;      // pointer past end of array
     char *i, *ii, *j, *jj;                  // scan pointers
@@ -115,23 +197,26 @@ void qsort(void *base, size_t nmemb, size_t size,
     int swap_type = 1;
     swapf_typ swapf, vecswapf;
 
-    vecswapf = swapf = swapbytes;
-    if ((ptr_to_int(left) | size) % sizeof(WORD)) {
-        ;  // unaligned or not multple of WORD size; swap bytes
-    } else if (size == sizeof(DWORD)) {
-        swapf = swapdword;
-        vecswapf = swapdwords;
-        if (size == sizeof(pref_typ))
-            swap_type = 0;
-    } else if (size == sizeof(WORD)) {
-        swapf = swapword;
-        vecswapf = swapwords;
-        if (size == sizeof(pref_typ))
-            swap_type = 0;
-    } else if ((size % sizeof(DWORD)) == 0) {
-        swapf = vecswapf = swapdwords;
-    } else if ((size % sizeof(WORD)) == 0) {
-        swapf = vecswapf = swapwords;
+#if INDIRECT
+    // Pointer array for indirect_sort(), with room for its tmp element;
+    // allocated on first use. If that fails, sort directly.
+    size_t maxind = size >= INDIRECTSIZE ? INDIRECTMAXBYTES / size : 0;
+    char **ptrs = NULL;
+    int indirect = maxind >= INDIRECTTHRESH && nmemb >= INDIRECTTHRESH;
+#endif
+    // swap_func() (swap.h) handles any size and alignment a wide move at a
+    // time, and swaps the runs of equal elements after the fat partition in
+    // one call. Aligned pointer-size elements are swapped inline.
+    vecswapf = swapf = swap_func;
+    if (ptr_to_int(left) % sizeof(pref_typ) == 0 && size == sizeof(pref_typ))
+        swap_type = 0;
+    // Approximate 2*ceil(lg(n + 1)), as in OpenBSD qsort(); deeper than
+    // that, a subfile is heapsorted (introsort).
+    for (size_t k = nmemb; k > 0; k >>= 1)
+        maxdepth += 2;
+    if (sh) {
+        depth = sh->depth;
+        maxdepth = sh->maxdepth;
     }
     for (;;) {
         nmemb = (limit - left) / size;
@@ -139,22 +224,97 @@ void qsort(void *base, size_t nmemb, size_t size,
             ;
         if (i == limit)                     // if already in order
             goto pop;
+#if INDIRECT
+        if (indirect && nmemb >= INDIRECTTHRESH && nmemb <= maxind) {
+            if (! ptrs && ! (ptrs = malloc(maxind * sizeof *ptrs + size)))
+                indirect = 0;
+            else {
+                indirect_sort(left, nmemb, size, compar, ptrs,
+                        (char *)(ptrs + maxind));
+                goto pop;
+            }
+        }
+#endif
         if (nmemb >= INSORTTHRESH) {        // otherwise use insertion sort
+            if (depth++ >= maxdepth) {      // too deep; use heapsort
+                qs22heapsort(left, nmemb, size, compar, swapf);
+                goto pop;
+            }
             char *right = limit - size;
             // best so far? fewer compares, a few more swaps
             char *p = left + (nmemb / 2) * size;
+            int fat = 0;                    // use fat partition, not block
+#if SAMPLE_PIVOT
+            size_t ns = 1, step = 0;
+            if (nmemb >= SAMPLETHRESH) {
+                while (ns * ns * 4 <= nmemb)
+                    ns *= 2;
+                ns--;                       // odd, so there is a median
+                step = (nmemb / ns) * size;
+                // If the sample is in order (or reversed), so may be the
+                // subfile; leave it to the ninther and the fat partition,
+                // which keep that order. On other data this stops after a
+                // compare or two.
+                int up = 1, down = 1;
+                for (size_t k = 1; k < ns && (up || down); k++) {
+                    int c = COMP(left + (k - 1) * step, left + k * step);
+                    up &= c <= 0;
+                    down &= c >= 0;
+                }
+                if (up || down)
+                    step = 0;
+            }
+            if (step) {
+                for (size_t k = 1; k < ns; k++) {
+                    SWAP(left + k * size, left + k * step);
+                }
+                qsort(left, ns, size, compar);
+                p = left + (ns / 2) * size;
+                // If the median equals a neighbour, there are likely many
+                // duplicates.
+                fat = COMP(p - size, p) == 0 || COMP(p, p + size) == 0;
+            } else
+#endif
             if (nmemb >= MIDTHRESH) {
                 char *pleft = left + size;
                 char *pright = right - size;
+                char *pmid = p;
                 if (nmemb >= MEDOF3THRESH) {
                     size_t k = (nmemb / 8) * size;
                     pleft = med3(pleft, left + k, left + k * 2, compar);
                     p = med3(p - k, p, p + k, compar);
                     pright = med3(right - k * 2, right - k, pright, compar);
+                    fat = pleft == left + k && p == pmid && pright == right - k;
+                    pmid = p;
                 }
                 p = med3(pleft, p, pright, compar);
+#if BLOCK_PARTITION
+                // If every median was the middle candidate, the subfile looks
+                // presorted (or reversed), and the symmetric swaps of the fat
+                // partition keep that order. If the pivot equals another
+                // candidate, there are likely many duplicates.
+                if (nmemb >= BLOCKTHRESH)
+                    fat = (fat && p == pmid)
+                            || (p != pleft && COMP(pleft, p) == 0)
+                            || (p != pright && COMP(p, pright) == 0);
+#endif
             }
 
+            ptrdiff_t lessthan, morethan;
+#if BLOCK_PARTITION
+            // Small elements in a big subfile: block partition, unless the
+            // fat partition looks better (above), or the element before the
+            // subfile equals the pivot, another sign of many duplicates.
+            if (size <= BLOCKMAXSIZE && nmemb >= BLOCKTHRESH && !fat
+                    && (left == (char *)base || COMP(left - size, p) != 0)) {
+                i = qs22block_partition(left, limit, p, size, compar, swapf,
+                        fixed);
+                lessthan = i - left;
+                morethan = right - i;
+                goto partitioned;
+            }
+#endif
+
             i = ii = left;                  // i scans left to right
             j = jj = right;                 // j scans right to left
             for (;;) {
@@ -197,28 +357,44 @@ void qsort(void *base, size_t nmemb, size_t size,
             if (p != i)
                 SWAP(p, i);
 
-            ptrdiff_t lessthan = i - ii;
+            lessthan = i - ii;
             size_t k = min(lessthan, ii - left);
             if (k)
                 vecswapf(left, i - k, k);
-            ptrdiff_t morethan = jj - i;
+            morethan = jj - i;
             k = min(morethan, right - jj);
             if (k)
                 vecswapf(i + size, limit - k, k);
+#if BLOCK_PARTITION
+partitioned:
+#endif
+#if COUNTSWAPS
+            qs22_parts++;
+            qs22_part_elems += nmemb;
+            qs22_part_smaller += min(lessthan, morethan) / size;
+            if (depth > qs22_part_depth)
+                qs22_part_depth = depth;
+#endif
 
             if (lessthan > morethan) {
-                if (lessthan > 1) {
+                if ((size_t)lessthan >= minshare) {
+                    sh->share(sh, left, lessthan / size, depth);
+                } else if (lessthan > 1) {
                     sp[0] = left;
                     sp[1] = left + lessthan;
+                    depthstack[(sp - stack) / 2] = depth;
                     sp += 2;                // increment stack pointer
                 }
                 if (morethan <= 1)
                     goto pop;
                 left = limit - morethan;
             } else {
-                if (morethan > 1) {
+                if ((size_t)morethan >= minshare) {
+                    sh->share(sh, limit - morethan, morethan / size, depth);
+                } else if (morethan > 1) {
                     sp[0] = limit - morethan;
                     sp[1] = limit;
+                    depthstack[(sp - stack) / 2] = depth;
                     sp += 2;                // increment stack pointer
                 }
                 if (lessthan <= 1)
@@ -227,6 +403,27 @@ void qsort(void *base, size_t nmemb, size_t size,
             }
 
         } else {                // else subfile is small, use insertion sort
+#if HOLE_INSERTION
+            if (size <= HOLEMAXSIZE) {
+                union { char c[HOLEMAXSIZE]; swap_align_t a; } holebuf;
+                char *hole = holebuf.c;     // aligned for compar
+                for (i = left + size; i < limit; i += size) {
+                    if (COMP(i - size, i) <= 0)
+                        continue;
+                    j = i - size;
+                    if (j == left || COMP(j - size, i) <= 0) {
+                        SWAP(j, i);         // one place back; just swap
+                        continue;
+                    }
+                    swap_copy(hole, i, size);
+                    for (j -= size; j != left && COMP(j - size, hole) > 0; )
+                        j -= size;
+                    swap_move(j + size, j, i - j);
+                    swap_copy(j, hole, size);
+                }
+                goto pop;
+            }
+#endif
             for (i = left + size; i < limit; i += size) {
                 for (j = i; j != left && COMP(j - size, j) > 0; j -= size) {
                     SWAP(j - size, j);
@@ -237,8 +434,48 @@ pop:
                 sp -= 2;                    // pop the left and limit
                 left = sp[0];
                 limit = sp[1];
+                depth = depthstack[(sp - stack) / 2];
             } else                          // else stack empty, done
                 break;
         }
     }
+#if INDIRECT
+    free(ptrs);
+#endif
+}
+
+// Run the copy of the sort for this size.
+static void qs22j_run(void *base, size_t nmemb, size_t size,
+        int (*compar)(const void *, const void *), qs22j_share *sh)
+{
+#if FIXED_SIZES
+#define FIXEDSIZE(n) case n: qs22j_sort(base, nmemb, n, compar, 1, sh); return;
+    switch (size) {
+        FIXEDSIZE(4)
+        FIXEDSIZE(8)
+        FIXEDSIZE(12)
+        FIXEDSIZE(16)
+        FIXEDSIZE(24)
+        FIXEDSIZE(32)
+    }
+#undef FIXEDSIZE
+#endif
+    qs22j_sort(base, nmemb, size, compar, 0, sh);
+}
+
+void qsort(void *base, size_t nmemb, size_t size,
+                                     int (*compar)(const void *, const void *))
+{
+    qs22j_run(base, nmemb, size, compar, NULL);
+}
+
+// qs22j_sub() (qs22.h) for the qs22j build; the same for qs22jd etc. is
+// named after their qsort (qs22jd_sub() and so on), and unused.
+#define SUBNAME(q)      SUBNAME_(q)
+#define SUBNAME_(q)     q##_sub
+
+void SUBNAME(qsort)(void *base, size_t nmemb, size_t size,
+        int (*compar)(const void *, const void *), qs22j_share *sh)
+{
+    qs22j_run(base, nmemb, size, compar, sh);
 }
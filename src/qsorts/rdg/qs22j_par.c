@@ -0,0 +1,213 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22j_par -- qs22j with the partition stack shared among threads.
+//
+// Each thread owns a deque of subfiles, and runs qs22j's own loop
+// (qs22j_sub(), qs22.h) on the subfiles it takes. Where that loop would stack
+// a part of PARTHRESH or more elements, it pushes it on the bottom of the
+// thread's deque instead, and goes on with the other part. An idle thread
+// steals from the top of another thread's deque, so it gets the largest
+// piece available. Smaller parts stay on the loop's stack and are sorted by
+// the thread that produced them. Only large subfiles go through a deque, so
+// a plain mutex per deque costs nothing measurable.
+//
+// Set qs22j_par_threads to the number of threads wanted; 0 (the default)
+// means one per online CPU.
+//
+// With COUNTSWAPS, the counters qs22j keeps are not atomic, so with more than
+// one thread they can come out low; time is what this is for.
+//
+#include <stddef.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "qs22.h"
+
+#define PARTHRESH       16384       // < this sort serially, don't share
+#define MAXTHREADS      256
+#define DEQUESIZE       (8*sizeof(size_t))  // power of 2, >= lg(max nmemb)
+
+void qs22j(void *base, size_t nmemb, size_t size,
+        int (*compar)(const void *, const void *));   // src/qs22j.c
+
+int qs22j_par_threads = 0;
+
+typedef struct {
+    char *left, *limit;
+    int depth;                      // partitioning depth, for introsort
+} subfile;
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t top, bottom;             // steal at top, push and pop at bottom
+    subfile item[DEQUESIZE];        // used as a ring, indexed mod DEQUESIZE
+} deque;
+
+typedef struct {
+    size_t size;
+    int (*compar)(const void *, const void *);
+    int maxdepth;                   // heapsort subfiles deeper than this
+    int nthreads;
+    size_t pending;                 // subfiles pushed and not yet sorted
+    deque *deques;
+} sortinfo;
+
+typedef struct {
+    sortinfo *si;
+    int id;
+    int started;                    // nonzero if thread created
+} worker_arg;
+
+static void push_bottom(deque *d, char *left, char *limit, int depth)
+{
+    pthread_mutex_lock(&d->lock);
+    d->item[d->bottom % DEQUESIZE].left = left;
+    d->item[d->bottom % DEQUESIZE].limit = limit;
+    d->item[d->bottom % DEQUESIZE].depth = depth;
+    d->bottom++;
+    pthread_mutex_unlock(&d->lock);
+}
+
+static int pop_bottom(deque *d, subfile *s)
+{
+    int found = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom != d->top) {
+        d->bottom--;
+        *s = d->item[d->bottom % DEQUESIZE];
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+static int steal_top(deque *d, subfile *s)
+{
+    int found = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom != d->top) {
+        *s = d->item[d->top % DEQUESIZE];
+        d->top++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+// qs22j_sub() hands over a part of PARTHRESH or more elements; push it on
+// this thread's deque, where other threads may steal it.
+static void share(qs22j_share *sh, void *base, size_t nmemb, int depth)
+{
+    sortinfo *si = ((worker_arg *)sh->ctx)->si;
+    deque *mine = &si->deques[((worker_arg *)sh->ctx)->id];
+
+    __atomic_add_fetch(&si->pending, 1, __ATOMIC_SEQ_CST);
+    push_bottom(mine, base, (char *)base + nmemb * si->size, depth);
+}
+
+static void *worker(void *arg)
+{
+    sortinfo *si = ((worker_arg *)arg)->si;
+    int id = ((worker_arg *)arg)->id;
+    deque *mine = &si->deques[id];
+    subfile s;
+    qs22j_share sh;
+
+    sh.minshare = PARTHRESH;
+    sh.share = share;
+    sh.ctx = arg;
+    sh.maxdepth = si->maxdepth;
+
+    for (;;) {
+        int found = pop_bottom(mine, &s);
+        for (int k = 1; ! found && k < si->nthreads; k++)
+            found = steal_top(&si->deques[(id + k) % si->nthreads], &s);
+        if (found) {
+            sh.depth = s.depth;
+            qs22j_sub(s.left, (s.limit - s.left) / si->size, si->size,
+                    si->compar, &sh);
+            __atomic_sub_fetch(&si->pending, 1, __ATOMIC_SEQ_CST);
+        } else if (__atomic_load_n(&si->pending, __ATOMIC_SEQ_CST) == 0) {
+            break;
+        } else {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+void qsort(void *base, size_t nmemb, size_t size,
+                                     int (*compar)(const void *, const void *))
+{
+    char *left = base;                      // set up char * base pointer
+    sortinfo si;
+
+    si.size = size;
+    si.compar = compar;
+
+    // Approximate 2*ceil(lg(n + 1)), as in OpenBSD qsort(); deeper than
+    // that, a subfile is heapsorted (introsort).
+    si.maxdepth = 0;
+    for (size_t k = nmemb; k > 0; k >>= 1)
+        si.maxdepth += 2;
+
+    int nthreads = qs22j_par_threads;
+    if (nthreads <= 0)
+        nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads > MAXTHREADS)
+        nthreads = MAXTHREADS;
+    deque *deques = NULL;
+    pthread_t *tid = NULL;
+    worker_arg *args = NULL;
+    if (nthreads > 1 && nmemb >= 2 * PARTHRESH) {
+        deques = malloc(nthreads * sizeof *deques);
+        tid = malloc(nthreads * sizeof *tid);
+        args = malloc(nthreads * sizeof *args);
+    }
+    if (! deques || ! tid || ! args) {      // small, one thread, or no memory
+        free(deques);
+        free(tid);
+        free(args);
+        qs22j(base, nmemb, size, compar);
+        return;
+    }
+
+    si.nthreads = nthreads;
+    si.deques = deques;
+    si.pending = 1;
+    for (int k = 0; k < nthreads; k++) {
+        pthread_mutex_init(&deques[k].lock, NULL);
+        deques[k].top = deques[k].bottom = 0;
+        args[k].si = &si;
+        args[k].id = k;
+    }
+    push_bottom(&deques[0], left, left + nmemb * size, 0);
+
+    // The calling thread is worker 0. If a thread can't be created, the
+    // others do its share.
+    for (int k = 1; k < nthreads; k++)
+        args[k].started = pthread_create(&tid[k], NULL, worker, &args[k]) == 0;
+    worker(&args[0]);
+    for (int k = 1; k < nthreads; k++)
+        if (args[k].started)
+            pthread_join(tid[k], NULL);
+    for (int k = 0; k < nthreads; k++)
+        pthread_mutex_destroy(&deques[k].lock);
+    free(deques);
+    free(tid);
+    free(args);
+}
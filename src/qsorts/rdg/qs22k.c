@@ -18,7 +18,9 @@ extern unsigned long long tot_swaps;
 #endif
 #include <stddef.h>
 #include <stdint.h>
-#include <string.h>
+
+#include "qs22heap.h"
+#include "swap.h"
 
 #define INSORTTHRESH    5           // if n < this use insertion sort
                                     // MUST be >= 2
@@ -28,8 +30,6 @@ extern unsigned long long tot_swaps;
 
 #define min(a,b) (((a) < (b)) ? (a) : (b))
 
-typedef int32_t WORD;
-typedef int64_t DWORD;
 typedef void *pref_typ;
 
 // if no uintptr_t, use Bentley-McIlroy trick (undefined behavior)
@@ -49,71 +49,6 @@ typedef void *pref_typ;
 
 #define  COMP(a, b)  ((*compar)((void *)(a), (void *)(b)))
 
-static void swapbytes(void *a0, void *b0, size_t n)
-{
-#if COUNTSWAPS
-    tot_swaps += n;
-#endif
-    char *a = a0, *b = b0, t;
-    do {ASWAP(*a, *b, t); a++; b++;} while (--n);
-}
-
-static void swapdword(void *a0, void *b0, size_t n)
-{
-#if COUNTSWAPS
-    tot_swaps += sizeof(DWORD);
-#endif
-    char *a = a0, *b = b0, t[8];
-    memcpy(t, a, 8);
-    memcpy(a, b, 8);
-    memcpy(b, t, 8);
-    (void)n;
-}
-
-static void swapdwords(void *a0, void *b0, size_t n)
-{
-#if COUNTSWAPS
-    tot_swaps += n;
-#endif
-    char *a = a0, *b = b0, t[8];
-    do {
-        memcpy(t, a, 8);
-        memcpy(a, b, 8);
-        memcpy(b, t, 8);
-        a += 8;
-        b += 8;
-        n -= 8;
-    } while (n);
-}
-
-static void swapword(void *a0, void *b0, size_t n)
-{
-#if COUNTSWAPS
-    tot_swaps += sizeof(WORD);
-#endif
-    char *a = a0, *b = b0, t[4];
-    memcpy(t, a, 4);
-    memcpy(a, b, 4);
-    memcpy(b, t, 4);
-    (void)n;
-}
-
-static void swapwords(void *a0, void *b0, size_t n)
-{
-#if COUNTSWAPS
-    tot_swaps += n;
-#endif
-    char *a = a0, *b = b0, t[4];
-    do {
-        memcpy(t, a, 4);
-        memcpy(a, b, 4);
-        memcpy(b, t, 4);
-        a += 4;
-        b += 4;
-        n -= 4;
-    } while (n);
-}
-
 typedef void (*swapf_typ)(void *, void *, size_t);
 
 static char *med3(char *a, char *b, char *c, int (*compar)(const void *, const void *))
@@ -127,6 +62,8 @@ void qsort(void *base, size_t nmemb, size_t size,
                                      int (*compar)(const void *, const void *))
 {
     char *stack[2*8*sizeof(size_t)], **sp = stack; // stack and stack pointer
+    int depthstack[8*sizeof(size_t)];       // depth of each stacked subfile
+    int depth = 0, maxdepth = 0;            // partitioning depth and limit
     char *left = base;                      // set up char * base pointer
     char *limit = left + nmemb * size;      // pointer past end of array
     char *i, *ii, *j, *jj;                  // scan pointers
@@ -134,24 +71,15 @@ void qsort(void *base, size_t nmemb, size_t size,
     int swap_type = 1;
     swapf_typ swapf, vecswapf;
 
-    vecswapf = swapf = swapbytes;
-    if ((ptr_to_int(left) | size) % sizeof(WORD)) {
-        ;  // unaligned or not multple of WORD size; swap bytes
-    } else if (size == sizeof(DWORD)) {
-        swapf = swapdword;
-        vecswapf = swapdwords;
-        if (size == sizeof(pref_typ))
-            swap_type = 0;
-    } else if (size == sizeof(WORD)) {
-        swapf = swapword;
-        vecswapf = swapwords;
-        if (size == sizeof(pref_typ))
-            swap_type = 0;
-    } else if ((size % sizeof(DWORD)) == 0) {
-        swapf = vecswapf = swapdwords;
-    } else if ((size % sizeof(WORD)) == 0) {
-        swapf = vecswapf = swapwords;
-    }
+    // swap_func() (swap.h) handles any size and alignment a wide move at a
+    // time. Aligned pointer-size elements are swapped inline.
+    vecswapf = swapf = swap_func;
+    if (ptr_to_int(left) % sizeof(pref_typ) == 0 && size == sizeof(pref_typ))
+        swap_type = 0;
+    // Approximate 2*ceil(lg(n + 1)), as in OpenBSD qsort(); deeper than
+    // that, a subfile is heapsorted (introsort).
+    for (size_t k = nmemb; k > 0; k >>= 1)
+        maxdepth += 2;
     for (;;) {
         nmemb = (limit - left) / size;
         for (i = left + size; i < limit && COMP(i - size, i) <= 0; i += size)
@@ -159,6 +87,10 @@ void qsort(void *base, size_t nmemb, size_t size,
         if (i == limit)                     // if already in order
             goto pop;
         if (nmemb >= INSORTTHRESH) {        // otherwise use insertion sort
+            if (depth++ >= maxdepth) {      // too deep; use heapsort
+                qs22heapsort(left, nmemb, size, compar, swapf);
+                goto pop;
+            }
             char *right = limit - size;
             // best so far? fewer compares, a few more swaps
             char *p = left + (nmemb / 2) * size;
@@ -229,6 +161,7 @@ void qsort(void *base, size_t nmemb, size_t size,
                 if (lessthan > 1) {
                     sp[0] = left;
                     sp[1] = left + lessthan;
+                    depthstack[(sp - stack) / 2] = depth;
                     sp += 2;                // increment stack pointer
                 }
                 if (morethan <= 1)
@@ -238,6 +171,7 @@ void qsort(void *base, size_t nmemb, size_t size,
                 if (morethan > 1) {
                     sp[0] = limit - morethan;
                     sp[1] = limit;
+                    depthstack[(sp - stack) / 2] = depth;
                     sp += 2;                // increment stack pointer
                 }
                 if (lessthan <= 1)
@@ -256,6 +190,7 @@ pop:
                 sp -= 2;                    // pop the left and limit
                 left = sp[0];
                 limit = sp[1];
+                depth = depthstack[(sp - stack) / 2];
             } else                          // else stack empty, done
                 break;
         }
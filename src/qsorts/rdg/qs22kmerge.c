@@ -0,0 +1,231 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22kmerge.c -- merge of k sorted runs into one, for combining the output
+// of workers that each sorted a piece. See qs22.h.
+//
+// The runs meet in a tournament tree of losers (Knuth, TAOCP vol. 3, 5.4.1):
+// each internal node holds the run that lost the match there, and node 0 the
+// overall winner, whose next element is output. Then only the path from
+// that run's leaf to the root is replayed, against the losers stored on it,
+// so each element output takes ceil(lg k) compares or fewer. Runs that are
+// used up lose every match. Ties go to the lower-numbered run, so the merge
+// is stable.
+//
+// As in timsort's galloping, when one run has won MINGALLOP times running,
+// the best of the others is found (the best of the losers on its path), and
+// a galloping search finds how many more elements the winner has before
+// that one's next; they are copied out as a block.
+//
+// qs22_kmerge_key() is the same with uint64 keys from key_fn() in place of
+// compar(): each run's next key is kept, so key_fn() is called about once
+// per element, and a match is an integer compare.
+//
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "qs22.h"
+#include "qs22merge.h"
+#include "swap.h"
+
+#define MINGALLOP       7           // gallop after this many wins running
+#define STACKRUNS       64          // up to this many runs, no malloc()
+
+#ifndef FIXED_SIZES
+#define FIXED_SIZES     1
+#endif
+
+#define INLINE inline __attribute__((always_inline))
+
+#define  COMP(a, b)  ((*compar)((void *)(a), (void *)(b)))
+
+typedef struct {
+    const char *p;                  // next element
+    const char *end;
+    uint64_t key;                   // its key, for qs22_kmerge_key()
+} run_t;
+
+// Does run i's next element come before run j's? Used-up runs come last,
+// and ties go to the lower-numbered run.
+static INLINE int before(run_t *r, size_t i, size_t j, qs22merge_cmp compar,
+        int keyed)
+{
+    if (r[i].p == r[i].end)
+        return 0;
+    if (r[j].p == r[j].end)
+        return 1;
+    if (keyed)
+        return r[i].key < r[j].key || (r[i].key == r[j].key && i < j);
+    int c = COMP(r[i].p, r[j].p);
+    return c < 0 || (c == 0 && i < j);
+}
+
+// How many of run w's elements, from its next, come before run o's next,
+// which run w's next does.
+static INLINE size_t gallop(run_t *r, size_t w, size_t o, size_t size,
+        qs22merge_cmp compar, uint64_t (*key_fn)(const void *), int keyed)
+{
+    size_t n = (r[w].end - r[w].p) / size;
+
+    if (r[o].p == r[o].end)
+        return n;
+    if (! keyed)
+        return qs22merge_gallop(r[o].p, (char *)r[w].p, n, w < o, 0,
+                size, compar);
+    // The same doubling, then binary, search as qs22merge_gallop(), on keys.
+    uint64_t key = r[o].key;
+    size_t lo = 1, hi = n, d = 3;
+
+#define keybefore(i) (w < o ? key_fn(r[w].p + (i) * size) <= key \
+                            : key_fn(r[w].p + (i) * size) < key)
+    while (d <= n && keybefore(d - 1)) {
+        lo = d;
+        d = 2 * d + 1;
+    }
+    if (d - 1 < hi)
+        hi = d - 1;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (keybefore(mid))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+#undef keybefore
+    return lo;
+}
+
+// Merge the k runs r[] to out, with compar() or, if keyed, key_fn(). tree[]
+// has room for 2k, the losers in tree[1..k) and the winner in tree[0]; the
+// first tournament keeps the winners of its matches in tree[k..2k).
+static INLINE void kmerge(run_t *r, size_t *tree, size_t k, size_t size,
+        qs22merge_cmp compar, uint64_t (*key_fn)(const void *), int keyed,
+        char *out)
+{
+    size_t *win = tree + k;
+    size_t n, w, last = k, wins = 0;
+
+    // Node n's children are 2n and 2n + 1; leaf k + i is run i.
+    for (n = k - 1; n > 0; n--) {
+        size_t a = 2 * n >= k ? 2 * n - k : win[2 * n];
+        size_t b = 2 * n + 1 >= k ? 2 * n + 1 - k : win[2 * n + 1];
+        if (before(r, b, a, compar, keyed)) {
+            tree[n] = a;
+            win[n] = b;
+        } else {
+            tree[n] = b;
+            win[n] = a;
+        }
+    }
+    w = k > 1 ? win[1] : 0;
+    while (r[w].p != r[w].end) {
+        size_t c = 1;
+        if (w != last) {
+            last = w;
+            wins = 0;
+        }
+        if (++wins >= MINGALLOP) {
+            size_t o = k;           // the best of the others
+            for (n = (k + w) / 2; n > 0; n /= 2)
+                if (o == k || before(r, tree[n], o, compar, keyed))
+                    o = tree[n];
+            c = o == k ? (size_t)(r[w].end - r[w].p) / size :
+                gallop(r, w, o, size, compar, key_fn, keyed);
+            wins = 0;
+        }
+        swap_copy(out, r[w].p, c * size);
+        out += c * size;
+        r[w].p += c * size;
+        if (keyed && r[w].p != r[w].end)
+            r[w].key = key_fn(r[w].p);
+        // Replay run w's path.
+        for (n = (k + w) / 2; n > 0; n /= 2) {
+            if (before(r, tree[n], w, compar, keyed)) {
+                size_t t = tree[n];
+                tree[n] = w;
+                w = t;
+            }
+        }
+    }
+}
+
+static INLINE void kmerge_sizes(run_t *r, size_t *tree, size_t k,
+        size_t size, qs22merge_cmp compar, uint64_t (*key_fn)(const void *),
+        int keyed, char *out)
+{
+#if FIXED_SIZES
+#define FIXEDSIZE(n) case n: \
+        kmerge(r, tree, k, n, compar, key_fn, keyed, out); return;
+    switch (size) {
+        FIXEDSIZE(4)
+        FIXEDSIZE(8)
+        FIXEDSIZE(12)
+        FIXEDSIZE(16)
+        FIXEDSIZE(24)
+        FIXEDSIZE(32)
+    }
+#undef FIXEDSIZE
+#endif
+    kmerge(r, tree, k, size, compar, key_fn, keyed, out);
+}
+
+// Set up the runs and the tree, on the stack if there are few enough runs,
+// and merge. Inline, so that each caller gets a copy for its own keyed.
+static INLINE int kmerge_runs(const void *const runs[], const size_t counts[],
+        size_t k, size_t size, qs22merge_cmp compar,
+        uint64_t (*key_fn)(const void *), int keyed, void *out)
+{
+    run_t stackruns[STACKRUNS], *r = stackruns;
+    size_t stacktree[2 * STACKRUNS], *tree = stacktree;
+
+    if (k == 0 || size == 0)
+        return 0;
+    if (k > STACKRUNS) {
+        if (k > SIZE_MAX / (sizeof *r + 2 * sizeof *tree)
+                || ! (r = malloc(k * (sizeof *r + 2 * sizeof *tree)))) {
+            errno = ENOMEM;
+            return -1;
+        }
+        tree = (size_t *)(r + k);
+    }
+    for (size_t i = 0; i < k; i++) {
+        r[i].p = runs[i];
+        r[i].end = r[i].p + counts[i] * size;
+        if (keyed && counts[i])
+            r[i].key = key_fn(r[i].p);
+    }
+    kmerge_sizes(r, tree, k, size, compar, key_fn, keyed, out);
+    if (r != stackruns)
+        free(r);
+    return 0;
+}
+
+// Merge runs[0..k), of counts[i] elements each, sorted by compar(), to out,
+// which must not overlap them. Stable, in run order. Returns 0, or -1 with
+// errno ENOMEM if k is more than STACKRUNS and it can't get space for them.
+int qs22_kmerge(const void *const runs[], const size_t counts[], size_t k,
+        size_t size, int (*compar)(const void *, const void *), void *out)
+{
+    return kmerge_runs(runs, counts, k, size, compar, NULL, 0, out);
+}
+
+// The same, with the runs sorted on key_fn() of their elements.
+int qs22_kmerge_key(const void *const runs[], const size_t counts[],
+        size_t k, size_t size, uint64_t (*key_fn)(const void *), void *out)
+{
+    return kmerge_runs(runs, counts, k, size, NULL, key_fn, 1, out);
+}
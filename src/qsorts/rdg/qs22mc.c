@@ -0,0 +1,223 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22mc.c -- qsort() that makes as few compares as it can, for compare
+// functions that cost much more than moving an element (collation, multi-key
+// records). It is QuickMergesort (Edelkamp and Weiss, "QuickXsort: A Fast
+// Sorting Scheme in Theory and Practice", Algorithmica, 2020), in place:
+//
+// Partition around the median of a sample of about sqrt(n) elements, merge
+// sort one part using the other as the merge buffer, and go on with the
+// other. The merges swap elements with the buffer instead of copying, so the
+// buffer's elements are only permuted. Merge sort leaves (32 to 63 elements)
+// are sorted by binary insertion, which makes fewer compares than merging
+// down to single elements. On random data that comes to about n lg n - 1.3n
+// compares at a million elements, within 1% of the lower bound lg(n!), which
+// is n lg n - 1.44n; qs22j makes about 15% more. The leaves cost more moves,
+// which is the trade this sort is for.
+//
+// The partition is three-way, so keys equal to the pivot are done with. Each
+// subfile is checked for being in order, and each merge for its runs being
+// in order already; on random data both stop after a compare or two. If
+// partitioning keeps going badly, the rest is heapsorted.
+//
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "qs22heap.h"
+#include "swap.h"
+
+#define INSORTTHRESH    64          // merge sort subfiles of < this use
+                                    // binary insertion sort
+#define QMSTHRESH       128         // sort subfiles of < this by binary
+                                    // insertion instead of partitioning
+#define HOLEMAXSIZE     256         // insert bigger elements by swaps
+
+#define min(a,b) (((a) < (b)) ? (a) : (b))
+
+#define  COMP(a, b)  ((*compar)((void *)(a), (void *)(b)))
+
+#define SWAP(a, b)  swap_elems(a, b, size)
+
+typedef int (*compar_typ)(const void *, const void *);
+
+// Binary insertion sort: the k+1st element is put in place with at most
+// ceil(lg(k + 1)) compares, then moved there through a hole.
+static void bininsert_sort(char *a, size_t n, size_t size, compar_typ compar)
+{
+    char hole[HOLEMAXSIZE];
+
+    for (size_t k = 1; k < n; k++) {
+        char *x = a + k * size, *p;
+        size_t lo = 0, hi = k;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (COMP(x, a + mid * size) < 0)
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        if (lo == k)
+            continue;
+        p = a + lo * size;
+        if (size <= HOLEMAXSIZE) {
+            swap_copy(hole, x, size);
+            swap_move(p + size, p, x - p);
+            swap_copy(p, hole, size);
+        } else {
+            for (; x > p; x -= size)
+                SWAP(x - size, x);
+        }
+    }
+}
+
+// Merge sort a[0..n) using b[] as the buffer; b needs room for n / 2
+// elements. Its elements are swapped into a[] and back, not overwritten.
+static void merge_sort(char *a, size_t n, char *b, size_t size,
+        compar_typ compar)
+{
+    if (n < INSORTTHRESH) {
+        bininsert_sort(a, n, size, compar);
+        return;
+    }
+    size_t n1 = n / 2;
+    char *m = a + n1 * size, *end = a + n * size;
+    merge_sort(a, n1, b, size, compar);
+    merge_sort(m, n - n1, b, size, compar);
+    if (COMP(m - size, m) <= 0)             // runs already in order
+        return;
+    // Swap the first run out to b[], then merge it and the second run into
+    // a[]. The buffer's elements fill the gap between output and second run.
+    swap_func(a, b, n1 * size);
+    char *i = b, *ie = b + n1 * size, *j = m, *k = a;
+    while (i < ie && j < end) {
+        if (COMP(j, i) < 0) {
+            SWAP(k, j);
+            j += size;
+        } else {
+            SWAP(k, i);
+            i += size;
+        }
+        k += size;
+    }
+    if (i < ie)
+        swap_func(k, i, ie - i);
+}
+
+// Partition a[1..n) around the pivot in a[0] (Bentley and McIlroy's fat
+// partition), using the sign of one compare per element. On return,
+// a[0..*lt) < pivot, a[*lt..*gt) == pivot, and a[*gt..n) > pivot.
+static void partition(char *a, size_t n, size_t size, compar_typ compar,
+        size_t *lt, size_t *gt)
+{
+    char *pa, *pb, *pc, *pd, *pn = a + n * size;
+    size_t s;
+    int r;
+
+    pa = pb = a + size;
+    pc = pd = pn - size;
+    for (;;) {
+        while (pb <= pc && (r = COMP(pb, a)) <= 0) {
+            if (r == 0) {
+                SWAP(pa, pb);
+                pa += size;
+            }
+            pb += size;
+        }
+        while (pb <= pc && (r = COMP(pc, a)) >= 0) {
+            if (r == 0) {
+                SWAP(pc, pd);
+                pd -= size;
+            }
+            pc -= size;
+        }
+        if (pb > pc)
+            break;
+        SWAP(pb, pc);
+        pb += size;
+        pc -= size;
+    }
+    s = min(pa - a, pb - pa);
+    if (s)
+        swap_func(a, pb - s, s);
+    s = min(pd - pc, pn - pd - (ptrdiff_t)size);
+    if (s)
+        swap_func(pb, pn - s, s);
+    *lt = (pb - pa) / size;
+    *gt = n - (pd - pc) / size;
+}
+
+static void qs22mc_sort(char *a, size_t n, size_t size, compar_typ compar)
+{
+    int bad = 0, maxbad = 0;
+
+    for (size_t k = n; k > 0; k >>= 1)
+        maxbad++;
+    while (n >= QMSTHRESH) {
+        char *i = a + size, *limit = a + n * size;
+        while (i < limit && COMP(i - size, i) <= 0)
+            i += size;
+        if (i == limit)                     // if already in order
+            return;
+        // Sample about sqrt(n) elements spread over the subfile, an odd
+        // number, into a[0..k) and sort them, for their median as pivot.
+        // Partitioning compares the sample again, but that is only
+        // about sqrt(n) compares, and one partition for all keeps the
+        // elements equal to the pivot together.
+        size_t k = 1, step;
+        while (k * k < n)
+            k++;
+        k |= 1;
+        step = n / k;
+        for (size_t t = 1; t < k; t++)
+            SWAP(a + t * size, a + t * step * size);
+        qs22mc_sort(a, k, size, compar);
+        SWAP(a, a + k / 2 * size);
+        size_t nl, nr;
+        partition(a, n, size, compar, &nl, &nr);
+        nr = n - nr;
+        // Merge sort the bigger part if the smaller can be its buffer, else
+        // the smaller; go on with the other.
+        char *big = a, *small = a + (n - nr) * size;
+        size_t nbig = nl, nsmall = nr;
+        if (nl < nr) {
+            char *t = big;
+            big = small;
+            small = t;
+            nbig = nr;
+            nsmall = nl;
+        }
+        if (nbig > n - n / 8 && ++bad > maxbad) {   // too lopsided too often
+            qs22heapsort(a, n, size, compar, swap_func);
+            return;
+        }
+        if (nsmall >= nbig / 2) {
+            merge_sort(big, nbig, small, size, compar);
+            a = small;
+            n = nsmall;
+        } else {
+            merge_sort(small, nsmall, big, size, compar);
+            a = big;
+            n = nbig;
+        }
+    }
+    bininsert_sort(a, n, size, compar);
+}
+
+void qsort(void *base, size_t nmemb, size_t size,
+                                     int (*compar)(const void *, const void *))
+{
+    qs22mc_sort(base, nmemb, size, compar);
+}
@@ -0,0 +1,293 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22merge.h -- the stable merge of two adjacent runs that qs22run does,
+// for the sorts that merge runs in place with little or no extra memory.
+//
+// qs22merge() merges a[0..n1) and a[n1..n1+n2), a stable merge: of equal
+// elements, those of the left run come first. It first skips the elements
+// of the left run that are not greater than the first of the right run, and
+// those of the right run that are not less than the last of the left,
+// finding each with a galloping (doubling, then binary) search. What
+// remains of the shorter run is copied to the scratch buffer and merged
+// back; as in timsort, when one run wins QS22MERGE_MINGALLOP times running,
+// the merge gallops to find how many more it wins and moves them as a block.
+// If the shorter run doesn't fit the buffer, the merge is split by rotations
+// into ones that do (qs22merge_rotmerge()); with no buffer at all, that is
+// the merge of Dudzinski and Dydek (as in C++'s inplace_merge() without a
+// buffer), about n lg n moves for a merge of n.
+//
+#ifndef QS22MERGE_H
+#define QS22MERGE_H
+
+#include <stddef.h>
+
+#include "swap.h"
+
+#define QS22MERGE_MINGALLOP 7       // gallop after this many wins running
+#define QS22MERGE_HOLEMAX   256     // insert bigger elements by swaps
+
+#define QS22MERGE_INLINE inline __attribute__((always_inline))
+
+typedef int (*qs22merge_cmp)(const void *, const void *);
+
+typedef struct {
+    char *buf;                      // scratch buffer
+    size_t cap;                     // its size in elements
+} qs22merge_buf;
+
+// Index of the first of a[0..n) that doesn't come before key: the first
+// greater than key if le, else the first not less than key. The search
+// doubles its step from the start, or from the end if fromend, then goes
+// binary, so it takes about 2 lg k compares for an answer k from that end.
+static QS22MERGE_INLINE size_t qs22merge_gallop(const char *key, char *a,
+        size_t n, int le, int fromend, size_t size, qs22merge_cmp compar)
+{
+    size_t lo = 0, hi = n, d = 1;
+
+#define before(i)   (le ? compar(a + (i) * size, key) <= 0 \
+                        : compar(a + (i) * size, key) < 0)
+    if (! fromend) {
+        while (d <= n && before(d - 1)) {
+            lo = d;
+            d = 2 * d + 1;
+        }
+        if (d - 1 < hi)
+            hi = d - 1;
+    } else {
+        while (d <= n && ! before(n - d)) {
+            hi = n - d;
+            d = 2 * d + 1;
+        }
+        if (d <= n)
+            lo = n - d + 1;
+    }
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (before(mid))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+#undef before
+    return lo;
+}
+
+// Reverse a[0..n).
+static QS22MERGE_INLINE void qs22merge_reverse(char *a, size_t n, size_t size)
+{
+    for (char *b = a + (n - 1) * size; a < b; a += size, b -= size)
+        swap_elems(a, b, size);
+}
+
+// Binary insertion sort of a[0..n), where a[0..k) is in order already. An
+// element goes after those equal to it, so it is stable.
+static QS22MERGE_INLINE void qs22merge_bininsert(char *a, size_t k, size_t n,
+        size_t size, qs22merge_cmp compar)
+{
+    char hole[QS22MERGE_HOLEMAX];
+
+    for (; k < n; k++) {
+        char *x = a + k * size, *p;
+        p = a + qs22merge_gallop(x, a, k, 1, 1, size, compar) * size;
+        if (p == x)
+            continue;
+        if (size <= QS22MERGE_HOLEMAX) {
+            swap_copy(hole, x, size);
+            swap_move(p + size, p, x - p);
+            swap_copy(p, hole, size);
+        } else {
+            for (; x > p; x -= size)
+                swap_elems(x - size, x, size);
+        }
+    }
+}
+
+// Merge a[0..n1) and a[n1..n1+n2), n1 <= s->cap, with the left run copied
+// to the buffer and merged forward.
+static QS22MERGE_INLINE void qs22merge_lo(char *a, size_t n1, size_t n2,
+        size_t size, qs22merge_cmp compar, qs22merge_buf *s)
+{
+    char *i = s->buf, *ie = i + n1 * size, *j = a + n1 * size;
+    char *je = j + n2 * size, *k = a;
+    int wi = 0, wj = 0;
+
+    swap_copy(i, a, n1 * size);
+    while (i < ie && j < je) {
+        if (compar(j, i) < 0) {
+            swap_copy(k, j, size);
+            k += size;
+            j += size;
+            wi = 0;
+            if (++wj >= QS22MERGE_MINGALLOP) {
+                size_t c = qs22merge_gallop(i, j, (je - j) / size, 0, 0,
+                        size, compar);
+                swap_move(k, j, c * size);
+                k += c * size;
+                j += c * size;
+                wj = 0;
+            }
+        } else {
+            swap_copy(k, i, size);
+            k += size;
+            i += size;
+            wj = 0;
+            if (++wi >= QS22MERGE_MINGALLOP) {
+                size_t c = qs22merge_gallop(j, i, (ie - i) / size, 1, 0,
+                        size, compar);
+                swap_copy(k, i, c * size);
+                k += c * size;
+                i += c * size;
+                wi = 0;
+            }
+        }
+    }
+    if (i < ie)                             // the rest of the right run is
+        swap_copy(k, i, ie - i);            // in place already
+}
+
+// The same, n2 <= s->cap, with the right run copied to the buffer and merged
+// backward from the end.
+static QS22MERGE_INLINE void qs22merge_hi(char *a, size_t n1, size_t n2,
+        size_t size, qs22merge_cmp compar, qs22merge_buf *s)
+{
+    char *i = a + n1 * size, *j = s->buf + n2 * size, *k = i + n2 * size;
+    int wi = 0, wj = 0;
+
+    swap_copy(s->buf, i, n2 * size);
+    while (i > a && j > s->buf) {
+        if (compar(j - size, i - size) < 0) {
+            k -= size;
+            i -= size;
+            swap_copy(k, i, size);
+            wj = 0;
+            if (++wi >= QS22MERGE_MINGALLOP) {
+                size_t c = (i - a) / size;
+                c -= qs22merge_gallop(j - size, a, c, 1, 1, size, compar);
+                k -= c * size;
+                i -= c * size;
+                swap_move(k, i, c * size);
+                wi = 0;
+            }
+        } else {
+            k -= size;
+            j -= size;
+            swap_copy(k, j, size);
+            wi = 0;
+            if (++wj >= QS22MERGE_MINGALLOP) {
+                size_t c = (j - s->buf) / size;
+                c -= qs22merge_gallop(i - size, s->buf, c, 0, 1, size, compar);
+                k -= c * size;
+                j -= c * size;
+                swap_copy(k, j, c * size);
+                wj = 0;
+            }
+        }
+    }
+    if (j > s->buf)                         // the rest of the left run is
+        swap_copy(a, s->buf, j - s->buf);   // in place already
+}
+
+// Exchange a[0..n1) and a[n1..n1+n2), through the buffer if the shorter
+// fits, by one block swap if they are the same length, else by three
+// reversals (quadsort's trinity_rotation()).
+__attribute__((unused))
+static void qs22merge_rotate(char *a, size_t n1, size_t n2, size_t size,
+        qs22merge_buf *s)
+{
+    char *m = a + n1 * size;
+
+    if (n1 == 0 || n2 == 0)
+        return;
+    if (n1 == n2 && n1 > s->cap) {
+        swap_func(a, m, n1 * size);
+    } else if (n1 <= n2 && n1 <= s->cap) {
+        swap_copy(s->buf, a, n1 * size);
+        swap_move(a, m, n2 * size);
+        swap_copy(a + n2 * size, s->buf, n1 * size);
+    } else if (n2 < n1 && n2 <= s->cap) {
+        swap_copy(s->buf, m, n2 * size);
+        swap_move(a + n2 * size, a, n1 * size);
+        swap_copy(a, s->buf, n2 * size);
+    } else {
+        qs22merge_reverse(a, n1, size);
+        qs22merge_reverse(m, n2, size);
+        qs22merge_reverse(a, n1 + n2, size);
+    }
+}
+
+// Merge a[0..n1) and a[n1..n1+n2) when the shorter run doesn't fit the
+// buffer (which may have no room at all): split the longer run in half, find
+// where its middle element goes in the other, rotate the pieces between into
+// place, and merge the two halves that leaves, each of which is likelier to
+// fit.
+__attribute__((unused))
+static void qs22merge_rotmerge(char *a, size_t n1, size_t n2, size_t size,
+        qs22merge_cmp compar, qs22merge_buf *s)
+{
+    while (n1 && n2) {
+        size_t k1, k2;
+        if (n1 <= s->cap && n1 <= n2) {
+            qs22merge_lo(a, n1, n2, size, compar, s);
+            return;
+        }
+        if (n2 <= s->cap && n2 < n1) {
+            qs22merge_hi(a, n1, n2, size, compar, s);
+            return;
+        }
+        if (n1 + n2 == 2) {
+            if (compar(a + size, a) < 0)
+                swap_elems(a, a + size, size);
+            return;
+        }
+        if (n1 >= n2) {
+            k1 = n1 / 2;
+            k2 = qs22merge_gallop(a + k1 * size, a + n1 * size, n2, 0, 0,
+                    size, compar);
+        } else {
+            k2 = n2 / 2;
+            k1 = qs22merge_gallop(a + (n1 + k2) * size, a, n1, 1, 0,
+                    size, compar);
+        }
+        qs22merge_rotate(a + k1 * size, n1 - k1, k2, size, s);
+        qs22merge_rotmerge(a, k1, k2, size, compar, s);
+        a += (k1 + k2) * size;
+        n1 -= k1;
+        n2 -= k2;
+    }
+}
+
+// Merge the runs a[0..n1) and a[n1..n1+n2).
+static QS22MERGE_INLINE void qs22merge(char *a, size_t n1, size_t n2,
+        size_t size, qs22merge_cmp compar, qs22merge_buf *s)
+{
+    char *m = a + n1 * size;
+    size_t k;
+
+    if (compar(m - size, m) <= 0)           // in order already
+        return;
+    k = qs22merge_gallop(m, a, n1, 1, 0, size, compar);
+    a += k * size;
+    n1 -= k;
+    n2 = qs22merge_gallop(m - size, m, n2, 0, 1, size, compar);
+    if (n1 <= n2 && n1 <= s->cap)
+        qs22merge_lo(a, n1, n2, size, compar, s);
+    else if (n2 < n1 && n2 <= s->cap)
+        qs22merge_hi(a, n1, n2, size, compar, s);
+    else
+        qs22merge_rotmerge(a, n1, n2, size, compar, s);
+}
+
+#endif
@@ -0,0 +1,102 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22mergeip.c -- stable merge of two adjacent sorted runs in one array,
+// for callers that keep an array sorted and add a sorted batch at its end,
+// instead of sorting it all again. See qs22.h.
+//
+// The merge is qs22merge() (qs22merge.h), as in qs22run: the runs are
+// trimmed by galloping searches, then the shorter run left is merged
+// through the caller's scratch buffer, or through CACHEBYTES on the stack if
+// that is more. If it doesn't fit, the merge is split by rotations into ones
+// that do. So it is O(n) with a buffer as big as the shorter run, and about
+// n lg(n / c) moves with a buffer of c elements, or none.
+//
+// qs22_resort_tail() is the same for a batch not yet sorted: it sorts the
+// new elements with qs22j, then merges them in. With k new elements, that
+// is about k lg k compares for the sort and k lg(n / k) for the merge,
+// which gallops through the stretches of the old ones that are in place
+// already; qs22j on the whole array would make about n lg n, as its check
+// for order stops at the first new element. The merge buffer is malloc()ed
+// if the stack cache is too small; if that fails it merges by rotations.
+//
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "qs22.h"
+#include "qs22merge.h"
+#include "swap.h"
+
+#ifndef CACHEBYTES
+#define CACHEBYTES      1024        // bytes of merge buffer on the stack
+#endif
+
+void qs22j(void *base, size_t nmemb, size_t size,
+        int (*compar)(const void *, const void *));   // src/qs22j.c
+
+#ifndef FIXED_SIZES
+#define FIXED_SIZES     1
+#endif
+
+// Merge base[0..n1) and base[n1..n1+n2), each sorted, into one sorted run.
+// Stable: of equal elements, those of the first run come first. scratch may
+// be NULL, or scratch_size bytes the merge can use.
+void qs22_merge_inplace(void *base, size_t n1, size_t n2, size_t size,
+        int (*compar)(const void *, const void *),
+        void *scratch, size_t scratch_size)
+{
+    union { char c[CACHEBYTES]; swap_align_t a; } cache;
+    qs22merge_buf s;
+
+    if (n1 == 0 || n2 == 0 || size == 0)
+        return;
+    s.buf = cache.c;
+    s.cap = CACHEBYTES / size;
+    if (scratch && scratch_size / size > s.cap) {
+        s.buf = scratch;
+        s.cap = scratch_size / size;
+    }
+#if FIXED_SIZES
+#define FIXEDSIZE(n) case n: qs22merge(base, n1, n2, n, compar, &s); return;
+    switch (size) {
+        FIXEDSIZE(4)
+        FIXEDSIZE(8)
+        FIXEDSIZE(12)
+        FIXEDSIZE(16)
+        FIXEDSIZE(24)
+        FIXEDSIZE(32)
+    }
+#undef FIXEDSIZE
+#endif
+    qs22merge(base, n1, n2, size, compar, &s);
+}
+
+// Sort the k_new elements after the n_sorted sorted ones at base, and merge
+// them in. Not stable: qs22j sorts the new ones.
+void qs22_resort_tail(void *base, size_t n_sorted, size_t k_new, size_t size,
+        int (*compar)(const void *, const void *))
+{
+    size_t nbuf = k_new < n_sorted ? k_new : n_sorted;
+    void *scratch = NULL;
+
+    if (k_new == 0 || size == 0)
+        return;
+    qs22j((char *)base + n_sorted * size, k_new, size, compar);
+    if (nbuf > CACHEBYTES / size)
+        scratch = malloc(nbuf * size);
+    qs22_merge_inplace(base, n_sorted, k_new, size, compar,
+            scratch, scratch ? nbuf * size : 0);
+    free(scratch);
+}
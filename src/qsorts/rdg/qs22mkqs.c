@@ -0,0 +1,194 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22mkqs.c -- multikey quicksort of string pointers (Bentley and Sedgewick,
+// "Fast Algorithms for Sorting and Searching Strings", SODA 1997). Like
+// quicksort, but each partition looks at one byte of each string, at the
+// depth where all strings in the subfile are known to agree before it, so
+// shared prefixes are scanned once per string rather than once per compare.
+//
+// The partition is the Bentley-McIlroy fat-pivot partition of qs22j, on the
+// byte at depth: bytes equal to the pivot byte are swapped to the ends as
+// they're found, then swapped to the middle. The < and > parts are sorted
+// at the same depth, the = part at depth + 1 (unless the pivot byte is the
+// NUL, when those strings are all equal). Pivot selection is as in qs22j.
+// When a partition finds all strings have the same byte, their common prefix
+// is measured and skipped in one pass, rather than a partition per byte.
+//
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qs22.h"
+
+#define INSORTTHRESH    16          // if n < this use insertion sort
+#define MIDTHRESH       20          // < this use middle as pivot
+#define MEDOF3THRESH    50          // < this use median-of-3 as pivot
+                                    // larger subfiles use med-of-3-medians
+#define STACKINIT       256         // initial stack size, in subfiles
+
+#define min(a,b) (((a) < (b)) ? (a) : (b))
+
+typedef struct {
+    char **a;
+    size_t n;
+    size_t depth;
+} subfile;
+
+#define CH(p)   ((unsigned char)(*(p))[depth])
+#define SWAP(a, b) do {char *t = *(a); *(a) = *(b); *(b) = t;} while (0)
+
+static void vecswap(char **a, char **b, size_t n)
+{
+    while (n--) {
+        SWAP(a, b);
+        a++;
+        b++;
+    }
+}
+
+static char **med3(char **a, char **b, char **c, size_t depth)
+{
+    return CH(a) < CH(b) ?
+        (CH(b) < CH(c) ? b : CH(a) < CH(c) ? c : a) :
+        (CH(b) > CH(c) ? b : CH(a) > CH(c) ? c : a);
+}
+
+static void insertion_sort(char **a, size_t n, size_t depth)
+{
+    for (size_t i = 1; i < n; i++)
+        for (size_t j = i; j && strcmp(a[j - 1] + depth, a[j] + depth) > 0;
+                j--)
+            SWAP(a + j - 1, a + j);
+}
+
+void qs22_mkqsort_str(char **base, size_t nmemb)
+{
+    subfile stack0[STACKINIT], *stack = stack0, *sp = stack;
+    size_t stacksize = STACKINIT;
+    char **left = base, **limit = base + nmemb;
+    char **i, **ii, **j, **jj;
+    size_t depth = 0;
+
+    for (i = left + 1; i < limit && strcmp(i[-1], *i) <= 0; i++)
+        ;
+    if (i >= limit)                         // if already in order
+        return;
+    for (;;) {
+        size_t n = limit - left;
+        if (n < INSORTTHRESH) {
+            insertion_sort(left, n, depth);
+            goto pop;
+        }
+        char **right = limit - 1;
+        char **p = left + n / 2;
+        if (n >= MIDTHRESH) {
+            char **pleft = left + 1;
+            char **pright = right - 1;
+            if (n >= MEDOF3THRESH) {
+                size_t k = n / 8;
+                pleft = med3(pleft, left + k, left + k * 2, depth);
+                p = med3(p - k, p, p + k, depth);
+                pright = med3(right - k * 2, right - k, pright, depth);
+            }
+            p = med3(pleft, p, pright, depth);
+        }
+        int v = CH(p), c;
+
+        i = ii = left;                      // i scans left to right
+        j = jj = right;                     // j scans right to left
+        for (;;) {
+            while (i <= j && (c = CH(i)) <= v) {
+                if (c == v) {
+                    SWAP(i, ii);
+                    ii++;
+                }
+                i++;
+            }
+            while (i <= j && (c = CH(j)) >= v) {
+                if (c == v) {
+                    SWAP(j, jj);
+                    jj--;
+                }
+                j--;
+            }
+            if (i > j)
+                break;
+            SWAP(i, j);
+            i++;
+            j--;
+        }
+
+        size_t lessthan = i - ii;
+        size_t k = min(lessthan, (size_t)(ii - left));
+        vecswap(left, i - k, k);
+        size_t morethan = jj - j;
+        k = min(morethan, (size_t)(right - jj));
+        vecswap(i, limit - k, k);
+
+        // Stack the < and > parts, and go on with the = part.
+        subfile parts[2] = {
+            {left, lessthan, depth},
+            {limit - morethan, morethan, depth}
+        };
+        for (int m = 0; m < 2; m++) {
+            if (parts[m].n < 2)
+                continue;
+            if (sp == stack + stacksize) {
+                subfile *t = malloc(2 * stacksize * sizeof *t);
+                if (! t) {                  // out of memory; slow but sure
+                    insertion_sort(parts[m].a, parts[m].n, depth);
+                    continue;
+                }
+                memcpy(t, stack, stacksize * sizeof *t);
+                if (stack != stack0)
+                    free(stack);
+                stack = t;
+                sp = stack + stacksize;
+                stacksize *= 2;
+            }
+            *sp++ = parts[m];
+        }
+        if (v == 0)                         // = part all equal strings
+            goto pop;
+        left += lessthan;
+        limit -= morethan;
+        depth++;
+        if (! lessthan && ! morethan) {
+            // All strings had the same byte at depth, so they probably
+            // share a longer prefix. Skip to the end of it in one pass.
+            char *s0 = *left + depth;
+            size_t lcp = strlen(s0);
+            for (i = left + 1; i < limit && lcp; i++) {
+                char *s = *i + depth;
+                size_t k = 0;
+                while (k < lcp && s[k] == s0[k])
+                    k++;
+                lcp = k;
+            }
+            depth += lcp;
+        }
+        continue;
+pop:
+        if (sp == stack)
+            break;
+        sp--;
+        left = sp->a;
+        limit = left + sp->n;
+        depth = sp->depth;
+    }
+    if (stack != stack0)
+        free(stack);
+}
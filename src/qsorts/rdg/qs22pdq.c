@@ -0,0 +1,463 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22pdq -- qs22j with the adaptive tricks of Orson Peters' pattern-defeating
+// quicksort (pdqsort, github.com/orlp/pdqsort):
+//  - A partition that leaves a part of more than 7/8 of the subfile is "bad".
+//    After a bad partition both parts get a few deterministic swaps to break
+//    up the pattern that fooled the pivot selection.
+//  - After lg n bad partitions the subfile is heapsorted.
+//  - If a partition exchanged nothing, the input may be nearly sorted, so
+//    each part gets an insertion sort that gives up after PARTIALINSLIMIT
+//    element moves.
+//  - If the element just before the subfile (which is <= everything in it)
+//    equals the pivot, then nothing is less than the pivot. The elements
+//    equal to it are moved to the left with a simpler two-way partition and
+//    dropped.
+//
+// Before partitioning, qsort() looks for runs at the head of the array:
+// ascending, or strictly descending, which are reversed. If the first run
+// is at least a quarter of the array, the rest is sorted (by qsort(), so it
+// gets the same look) and merged with it (qs22_merge_inplace()). Otherwise
+// runs are scanned from the head while they average at least MINAVGRUN
+// elements, up to n / RUNSCANFRAC elements; if they still do there, the
+// array looks like sorted data with scattered changes, and it goes to the
+// natural merge sort qs22run. Random data gives up the scan after a dozen
+// or so elements.
+//
+// The sort is compiled once for each of the element sizes 4, 8, 12, 16, 24
+// and 32 bytes, with swaps inlined for that size, and once for other sizes,
+// as in qs22j.
+//
+#if COUNTSWAPS
+extern unsigned long long tot_swaps;
+#endif
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "qs22.h"
+#include "qs22block.h"
+#include "qs22heap.h"
+#include "swap.h"
+
+void qs22run(void *base, size_t nmemb, size_t size,
+        int (*compar)(const void *, const void *));   // src/qs22run.c
+
+#define INSORTTHRESH    5           // if n < this use insertion sort
+                                    // MUST be >= 2
+#define MIDTHRESH       20          // < this use middle as pivot
+#define MEDOF3THRESH    50          // < this use median-of-3 as pivot
+                                    // larger subfiles use med-of-3-medians
+#define ADAPTTHRESH     24          // < this skip the pdqsort checks
+#define BLOCKTHRESH     256         // block partition subfiles this big
+#define BLOCKMAXSIZE    16          // of elements this small
+#define SAMPLETHRESH    (1 << 12)   // pivot from a sample, as in qs22j
+#define PARTIALINSLIMIT 8           // max elements moved by partial
+                                    // insertion sort before giving up
+#define RUNSCANTHRESH   64          // < this don't look for runs
+#define MINAVGRUN       8           // shorter runs on average: partition
+#define RUNSCANFRAC     16          // scan at most n / this for runs
+
+#ifndef FIXED_SIZES
+#define FIXED_SIZES     1
+#endif
+
+#define min(a,b) (((a) < (b)) ? (a) : (b))
+
+typedef void *pref_typ;
+
+// if no uintptr_t, use Bentley-McIlroy trick (undefined behavior)
+//#define ptr_to_int(p) (p-(char*)0)
+#define ptr_to_int(p) ((uintptr_t)(void *)p)
+
+#define ASWAP(a, b, t) ((void)(t = a, a = b, b = t))
+
+#if COUNTSWAPS
+#define SWAP(a, b) if (fixed) swap_elems(a, b, size);\
+    else if (swap_type) swapf(a, b, size);\
+    else do {tot_swaps += sizeof(pref_typ);\
+            pref_typ t; ASWAP(*(pref_typ*)(a), *(pref_typ*)(b), t);} while (0)
+#else
+#define SWAP(a, b) if (fixed) swap_elems(a, b, size);\
+    else if (swap_type) swapf(a, b, size);\
+    else do {pref_typ t; ASWAP(*(pref_typ*)(a), *(pref_typ*)(b), t);} while (0)
+#endif
+
+#define  COMP(a, b)  ((*compar)((void *)(a), (void *)(b)))
+
+typedef void (*swapf_typ)(void *, void *, size_t);
+
+#define INLINE inline __attribute__((always_inline))
+
+static char *med3(char *a, char *b, char *c, int (*compar)(const void *, const void *))
+{
+    return COMP(a, b) < 0 ?
+        (COMP(b, c) < 0 ? b : COMP(a, c) < 0 ? c : a) :
+        (COMP(b, c) > 0 ? b : COMP(a, c) > 0 ? c : a);
+}
+
+// Insertion sort that gives up once it has moved PARTIALINSLIMIT elements.
+// Returns nonzero if [left, limit) is now sorted.
+static INLINE int partial_insertion_sort(char *left, char *limit,
+        size_t size, int (*compar)(const void *, const void *), int fixed,
+        int swap_type, swapf_typ swapf)
+{
+    size_t moved = 0;
+    char *i, *j;
+    for (i = left + size; i < limit; i += size) {
+        for (j = i; j != left && COMP(j - size, j) > 0; j -= size) {
+            SWAP(j - size, j);
+            moved++;
+        }
+        if (moved > PARTIALINSLIMIT)
+            return i + size == limit;
+    }
+    return 1;
+}
+
+// Break up a pattern in part [left, limit) by swapping a few elements near
+// each end with elements about a quarter of the way in.
+static INLINE void shuffle(char *left, char *limit, size_t size, int fixed,
+        int swap_type, swapf_typ swapf)
+{
+    size_t n = (limit - left) / size;
+    if (n < ADAPTTHRESH)
+        return;
+    size_t k = (n / 4) * size;
+    SWAP(left, left + k);
+    SWAP(limit - size, limit - size - k);
+    if (n >= MEDOF3THRESH) {
+        SWAP(left + size, left + k + size);
+        SWAP(left + 2 * size, left + k + 2 * size);
+        SWAP(limit - 2 * size, limit - size - k - size);
+        SWAP(limit - 3 * size, limit - size - k - 2 * size);
+    }
+}
+
+static void qs22pdq_run(void *base, size_t nmemb, size_t size,
+        int (*compar)(const void *, const void *));
+
+// The sort proper, inlined into qs22pdq_run() once per fixed size, as in
+// qs22j.
+static INLINE void qs22pdq_sort(void *base, size_t nmemb, size_t size,
+        int (*compar)(const void *, const void *), int fixed)
+{
+    char *stack[2*8*sizeof(size_t)], **sp = stack; // stack and stack pointer
+    int badstack[8*sizeof(size_t)];         // bad partitions left, per subfile
+    int bad_allowed = 0;                    // bad partitions before heapsort
+    char *left = base;                      // set up char * base pointer
+    char *limit = left + nmemb * size;      // pointer past end of array
+    char *i, *ii, *j, *jj;                  // scan pointers
+    int ki = 0, kj = 0;
+    int swap_type = 1;
+    swapf_typ swapf, vecswapf;
+
+    // swap_func() (swap.h) handles any size and alignment a wide move at a
+    // time. Aligned pointer-size elements are swapped inline.
+    vecswapf = swapf = swap_func;
+    if (ptr_to_int(left) % sizeof(pref_typ) == 0 && size == sizeof(pref_typ))
+        swap_type = 0;
+    for (size_t k = nmemb; k > 1; k >>= 1)  // floor(lg n), as in pdqsort
+        bad_allowed++;
+    for (;;) {
+        nmemb = (limit - left) / size;
+        for (i = left + size; i < limit && COMP(i - size, i) <= 0; i += size)
+            ;
+        if (i == limit)                     // if already in order
+            goto pop;
+        if (nmemb >= INSORTTHRESH) {        // otherwise use insertion sort
+            char *right = limit - size;
+            char *p = left + (nmemb / 2) * size;
+            int fat = 0;                    // use fat partition, not block
+            size_t ns = 1, step = 0;
+            if (nmemb >= SAMPLETHRESH) {
+                // As in qs22j, the pivot is the median of a sample of about
+                // sqrt(n) elements, sorted at the front; if the sample is in
+                // order (or reversed), the ninther is used instead.
+                while (ns * ns * 4 <= nmemb)
+                    ns *= 2;
+                ns--;                       // odd, so there is a median
+                step = (nmemb / ns) * size;
+                int up = 1, down = 1;
+                for (size_t k = 1; k < ns && (up || down); k++) {
+                    int c = COMP(left + (k - 1) * step, left + k * step);
+                    up &= c <= 0;
+                    down &= c >= 0;
+                }
+                if (up || down)
+                    step = 0;
+            }
+            if (step) {
+                for (size_t k = 1; k < ns; k++) {
+                    SWAP(left + k * size, left + k * step);
+                }
+                qs22pdq_run(left, ns, size, compar);
+                p = left + (ns / 2) * size;
+                fat = COMP(p - size, p) == 0 || COMP(p, p + size) == 0;
+            } else if (nmemb >= MIDTHRESH) {
+                char *pleft = left + size;
+                char *pright = right - size;
+                char *pmid = p;
+                if (nmemb >= MEDOF3THRESH) {
+                    size_t k = (nmemb / 8) * size;
+                    pleft = med3(pleft, left + k, left + k * 2, compar);
+                    p = med3(p - k, p, p + k, compar);
+                    pright = med3(right - k * 2, right - k, pright, compar);
+                    fat = pleft == left + k && p == pmid && pright == right - k;
+                    pmid = p;
+                }
+                p = med3(pleft, p, pright, compar);
+                // As in qs22j: if every median was the middle candidate, the
+                // subfile looks presorted; the fat partition keeps that
+                // order, and tells if it made no exchanges. If the pivot
+                // equals another candidate, there are likely many duplicates.
+                if (nmemb >= BLOCKTHRESH)
+                    fat = (fat && p == pmid)
+                            || (p != pleft && COMP(pleft, p) == 0)
+                            || (p != pright && COMP(p, pright) == 0);
+            }
+
+            // If the element before this subfile equals the pivot, nothing
+            // here is less than the pivot. Move the equal ones to the left
+            // and go on with the rest. The predecessor stays put, so compare
+            // against it rather than the pivot. (Not worth a compare on
+            // small subfiles.)
+            if (nmemb >= MIDTHRESH && left != base
+                    && COMP(left - size, p) == 0) {
+                char *pv = left - size;
+                i = left;
+                j = right;
+                for (;;) {
+                    while (i <= j && COMP(i, pv) <= 0)
+                        i += size;
+                    while (i < j && COMP(j, pv) > 0)
+                        j -= size;
+                    if (i >= j)
+                        break;
+                    SWAP(i, j);
+                    i += size;
+                    j -= size;
+                }
+                if (limit - i <= (ptrdiff_t)size)
+                    goto pop;
+                left = i;
+                continue;
+            }
+
+            int exchanged = 0;              // any i, j exchange?
+            ptrdiff_t lessthan, morethan;
+            if (size <= BLOCKMAXSIZE && nmemb >= BLOCKTHRESH && ! fat) {
+                i = qs22block_partition(left, limit, p, size, compar, swapf,
+                        fixed);
+                lessthan = i - left;
+                morethan = right - i;
+                exchanged = 1;              // (not known; assume so)
+                goto partitioned;
+            }
+
+            i = ii = left;                  // i scans left to right
+            j = jj = right;                 // j scans right to left
+            for (;;) {
+
+                while (i <= j) {
+                    if (i != p && ((ki = COMP(i, p)) >= 0)) {
+                        if (ki)
+                            break;
+                        if (ii == p)
+                            p = i;
+                        else if (i != ii) {
+                            SWAP(i, ii);
+                        }
+                        ii += size;
+                    }
+                    i += size;
+                }
+
+                while (i < j) {
+                    if (j != p && ((kj = COMP(j, p)) <= 0)) {
+                        if (kj)
+                            break;
+                        if (jj == p)
+                            p = j;
+                        else if (j != jj) {
+                            SWAP(j, jj);
+                        }
+                        jj -= size;
+                    }
+                    j -= size;
+                }
+
+                if (i >= j)
+                    break;
+                SWAP(i, j);
+                exchanged = 1;
+                i += size;
+                j -= size;
+            }
+
+            if (p < i)
+                i -= size;
+            if (p != i) {
+                SWAP(p, i);
+            }
+
+            lessthan = i - ii;
+            size_t k = min(lessthan, ii - left);
+            if (k)
+                vecswapf(left, i - k, k);
+            morethan = jj - i;
+            k = min(morethan, right - jj);
+            if (k)
+                vecswapf(i + size, limit - k, k);
+partitioned:
+
+            // Parts are [left, less) and [more, limit).
+            char *less = left + lessthan, *more = limit - morethan;
+            size_t big = (size_t)(lessthan > morethan ? lessthan : morethan);
+            if (nmemb < ADAPTTHRESH) {
+                ;
+            } else if (big / size > nmemb - nmemb / 8) {    // bad partition
+                if (--bad_allowed <= 0) {
+                    if (lessthan > (ptrdiff_t)size)
+                        qs22heapsort(left, lessthan / size, size, compar,
+                                swapf);
+                    if (morethan > (ptrdiff_t)size)
+                        qs22heapsort(more, morethan / size, size, compar,
+                                swapf);
+                    goto pop;
+                }
+                shuffle(left, less, size, fixed, swap_type, swapf);
+                shuffle(more, limit, size, fixed, swap_type, swapf);
+            } else if (! exchanged) {       // maybe nearly sorted
+                if (partial_insertion_sort(left, less, size, compar, fixed,
+                            swap_type, swapf))
+                    lessthan = 0;
+                if (partial_insertion_sort(more, limit, size, compar, fixed,
+                            swap_type, swapf))
+                    morethan = 0;
+            }
+
+            if (lessthan > morethan) {
+                if (lessthan > 1) {
+                    sp[0] = left;
+                    sp[1] = less;
+                    badstack[(sp - stack) / 2] = bad_allowed;
+                    sp += 2;                // increment stack pointer
+                }
+                if (morethan <= 1)
+                    goto pop;
+                left = more;
+            } else {
+                if (morethan > 1) {
+                    sp[0] = more;
+                    sp[1] = limit;
+                    badstack[(sp - stack) / 2] = bad_allowed;
+                    sp += 2;                // increment stack pointer
+                }
+                if (lessthan <= 1)
+                    goto pop;
+                limit = less;
+            }
+
+        } else {                // else subfile is small, use insertion sort
+            for (i = left + size; i < limit; i += size) {
+                for (j = i; j != left && COMP(j - size, j) > 0; j -= size) {
+                    SWAP(j - size, j);
+                }
+            }
+pop:
+            if (sp != stack) {              // if any entries on stack
+                sp -= 2;                    // pop the left and limit
+                left = sp[0];
+                limit = sp[1];
+                bad_allowed = badstack[(sp - stack) / 2];
+            } else                          // else stack empty, done
+                break;
+        }
+    }
+}
+
+// Run the copy of the sort for this size.
+static void qs22pdq_run(void *base, size_t nmemb, size_t size,
+        int (*compar)(const void *, const void *))
+{
+#if FIXED_SIZES
+#define FIXEDSIZE(n) case n: qs22pdq_sort(base, nmemb, n, compar, 1); return;
+    switch (size) {
+        FIXEDSIZE(4)
+        FIXEDSIZE(8)
+        FIXEDSIZE(12)
+        FIXEDSIZE(16)
+        FIXEDSIZE(24)
+        FIXEDSIZE(32)
+    }
+#undef FIXEDSIZE
+#endif
+    qs22pdq_sort(base, nmemb, size, compar, 0);
+}
+
+// Length of the run at the head of a[0..n), n >= 1: ascending, or strictly
+// descending, in which case it is reversed.
+static size_t head_run(char *a, size_t n, size_t size,
+        int (*compar)(const void *, const void *))
+{
+    size_t k = 1;
+    if (n >= 2 && COMP(a, a + size) > 0) {
+        for (k = 2; k < n && COMP(a + (k - 1) * size, a + k * size) > 0; k++)
+            ;
+        for (char *i = a, *j = a + (k - 1) * size; i < j; i += size, j -= size)
+            swap_func(i, j, size);
+    } else {
+        while (k < n && COMP(a + (k - 1) * size, a + k * size) <= 0)
+            k++;
+    }
+    return k;
+}
+
+void qsort(void *base, size_t nmemb, size_t size,
+                                     int (*compar)(const void *, const void *))
+{
+    char *a = base;
+
+    if (nmemb >= RUNSCANTHRESH && size != 0) {
+        size_t r = head_run(a, nmemb, size, compar);
+        if (r == nmemb)
+            return;
+        if (r >= nmemb / 4) {               // long first run; merge the rest
+            size_t rest = nmemb - r, nbuf = min(r, rest);
+            qsort(a + r * size, rest, size, compar);
+            void *scratch = malloc(nbuf * size);    // NULL: use rotations
+            qs22_merge_inplace(a, r, rest, size, compar,
+                    scratch, scratch ? nbuf * size : 0);
+            free(scratch);
+            return;
+        }
+        // Go on while the runs average MINAVGRUN, allowing a few short ones
+        // at first.
+        size_t scanned = r, runs = 1, bound = nmemb / RUNSCANFRAC;
+        while (scanned < bound
+                && runs * MINAVGRUN <= scanned + 4 * MINAVGRUN) {
+            scanned += head_run(a + scanned * size, nmemb - scanned, size,
+                    compar);
+            runs++;
+        }
+        if (scanned >= bound && runs * MINAVGRUN <= scanned) {
+            qs22run(base, nmemb, size, compar);
+            return;
+        }
+    }
+    qs22pdq_run(base, nmemb, size, compar);
+}
@@ -0,0 +1,139 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22radix.c -- LSD radix sort on uint64 keys taken from the elements by a
+// caller-supplied function, for sorting records by an integer or floating
+// key without any compares. See qs22.h for making order-preserving keys.
+//
+// The keys are extracted once, paired with the element indexes, and the
+// pairs are sorted by LSD radix sort, ping-ponging with a scratch array.
+// Then the elements are put in order with one pass through a scratch copy.
+// The keys are first reduced by the smallest key, so the number of passes
+// depends on the range of keys, not their size. The digits are up to
+// MAXDIGITBITS wide, balanced over the passes (e.g. 32 bits of range is 3
+// passes of 11 bits; 16 bits is 2 passes of 8). A pass is skipped when all
+// keys have the same digit there, and the whole sort when the keys are
+// already in order.
+//
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "qs22.h"
+
+#define MAXDIGITBITS    11
+#define MAXPASSES       ((64 + MAXDIGITBITS - 1) / MAXDIGITBITS)
+#define INSORTTHRESH    32          // if n < this use insertion sort
+
+typedef struct {
+    uint64_t key;
+    size_t idx;
+} keyidx;
+
+static void insertion_sort(keyidx *a, size_t n)
+{
+    for (size_t i = 1; i < n; i++) {
+        keyidx t = a[i];
+        size_t j = i;
+        for ( ; j && t.key < a[j - 1].key; j--)
+            a[j] = a[j - 1];
+        a[j] = t;
+    }
+}
+
+// Sort nmemb elements of size bytes at base into ascending order of
+// key_fn(element). Stable. Returns 0, or -1 with errno ENOMEM (and the array
+// unchanged) if it can't get scratch space.
+int qs22_radix_sort(void *base, size_t nmemb, size_t size,
+        uint64_t (*key_fn)(const void *))
+{
+    char *b = base;
+    if (nmemb < 2)
+        return 0;
+    if (nmemb > (SIZE_MAX - 2 * sizeof(keyidx)) / (2 * sizeof(keyidx) + size)) {
+        errno = ENOMEM;
+        return -1;
+    }
+    keyidx *a = malloc(nmemb * (2 * sizeof(keyidx) + size));
+    if (! a) {
+        errno = ENOMEM;
+        return -1;
+    }
+    keyidx *t = a + nmemb;
+    char *elts = (char *)(t + nmemb);
+
+    uint64_t lo = UINT64_MAX, hi = 0;
+    int inorder = 1;
+    for (size_t i = 0; i < nmemb; i++) {
+        uint64_t k = key_fn(b + i * size);
+        a[i].key = k;
+        a[i].idx = i;
+        if (k < hi)
+            inorder = 0;
+        if (k < lo)
+            lo = k;
+        if (k > hi)
+            hi = k;
+    }
+    if (inorder)                            // if already in order
+        goto done;
+
+    if (nmemb < INSORTTHRESH) {
+        insertion_sort(a, nmemb);
+    } else {
+        int bits = 64 - __builtin_clzll(hi - lo);
+        int passes = (bits + MAXDIGITBITS - 1) / MAXDIGITBITS;
+        int width = (bits + passes - 1) / passes;
+        uint64_t mask = ((uint64_t)1 << width) - 1;
+        size_t (*count)[1 << MAXDIGITBITS] =
+            calloc(passes, sizeof *count);
+        if (! count) {
+            free(a);
+            errno = ENOMEM;
+            return -1;
+        }
+        for (size_t i = 0; i < nmemb; i++) {
+            uint64_t k = a[i].key -= lo;
+            for (int p = 0; p < passes; p++)
+                count[p][(k >> (p * width)) & mask]++;
+        }
+        for (int p = 0; p < passes; p++) {
+            size_t *c = count[p], sum = 0;
+            int shift = p * width;
+            if (c[(a[0].key >> shift) & mask] == nmemb)
+                continue;                   // all the same digit; skip
+            for (size_t d = 0; d <= mask; d++) {
+                size_t n = c[d];
+                c[d] = sum;
+                sum += n;
+            }
+            for (size_t i = 0; i < nmemb; i++)
+                t[c[(a[i].key >> shift) & mask]++] = a[i];
+            keyidx *x = a;
+            a = t;
+            t = x;
+        }
+        free(count);
+    }
+
+    for (size_t i = 0; i < nmemb; i++)
+        memcpy(elts + i * size, b + a[i].idx * size, size);
+    memcpy(b, elts, nmemb * size);
+done:
+    free(a < t ? a : t);
+    return 0;
+}
@@ -0,0 +1,168 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22run.c -- stable natural merge sort, for data that is mostly in order
+// already ("sorted with a few changes"). It runs in about linear time on
+// such data, and n lg n on random data.
+//
+// The array is scanned for runs: ascending, or strictly descending (which
+// are reversed; strictly, so as to stay stable). Runs shorter than MINRUN
+// are extended to MINRUN elements by binary insertion sort. Runs are merged
+// as they are found by the powersort policy (Munro and Wild, "Nearly-Optimal
+// Mergesorts", ESA 2018): each boundary between two runs gets a power, the
+// depth in a binary split of the array where the split falls between the
+// runs' midpoints, and runs are merged while the boundary on top of the
+// stack has a higher power than the new one. That is within a few percent
+// of the cheapest merge order for any run lengths.
+//
+// The merges are those of qs22merge.h: trimmed by galloping searches, then
+// merged through the scratch buffer, galloping again when one run keeps
+// winning, as in timsort.
+//
+// The scratch buffer is at most SCRATCHMAXBYTES, or n / 2 elements if that
+// is less, and is on the stack if small enough. A merge whose shorter run
+// doesn't fit is split by rotations into ones that do.
+// If malloc() fails, everything is merged that way.
+//
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "qs22merge.h"
+#include "swap.h"
+
+#define MINRUN          32          // shorter runs get insertion sort
+#ifndef SCRATCHMAXBYTES
+#define SCRATCHMAXBYTES (1024 * 1024)
+#endif
+#define STACKSCRATCH    1024        // bytes of scratch on the stack
+
+#ifndef FIXED_SIZES
+#define FIXED_SIZES     1
+#endif
+
+#define min(a,b) (((a) < (b)) ? (a) : (b))
+
+#define INLINE inline __attribute__((always_inline))
+
+#define  COMP(a, b)  ((*compar)((void *)(a), (void *)(b)))
+
+// Powersort's power of the boundary between the runs [s1, s1 + n1) and
+// [s1 + n1, s1 + n1 + n2) of an array of n: the first bit where the
+// binary fractions (midpoint / n) of the two runs differ.
+static INLINE int power(size_t s1, size_t n1, size_t n2, size_t n)
+{
+    size_t a = 2 * s1 + n1, b = a + n1 + n2;    // twice the midpoints
+    int p = 0;
+
+    n *= 2;
+    for (;;) {
+        p++;
+        a *= 2;
+        b *= 2;
+        if (a >= n) {
+            a -= n;
+            b -= n;
+        } else if (b >= n) {
+            return p;
+        }
+    }
+}
+
+static INLINE void qs22run_sort(char *base, size_t nmemb, size_t size,
+        qs22merge_cmp compar)
+{
+    // Powers on the stack strictly increase, and are at most lg n + 1.
+    struct {
+        size_t start, n;
+        int power;
+    } stack[8 * sizeof(size_t) + 2];
+    int top = 0;
+    union { char c[STACKSCRATCH]; swap_align_t a; } stackbuf;
+    qs22merge_buf s;
+    size_t lo = 0;
+
+    if (nmemb < 2)
+        return;
+    s.cap = nmemb / 2;
+    if (s.cap > SCRATCHMAXBYTES / size)
+        s.cap = SCRATCHMAXBYTES / size;
+    if (s.cap <= STACKSCRATCH / size) {
+        s.buf = stackbuf.c;
+    } else if (! (s.buf = malloc(s.cap * size))) {
+        s.buf = stackbuf.c;
+        s.cap = STACKSCRATCH / size;
+    }
+    while (lo < nmemb) {
+        char *a = base + lo * size, *p = a + size, *end = base + nmemb * size;
+        size_t n;
+        // Find the run at lo.
+        if (p < end && COMP(a, p) > 0) {
+            while (p + size < end && COMP(p, p + size) > 0)
+                p += size;
+            p += size;
+            qs22merge_reverse(a, (p - a) / size, size);
+        } else {
+            while (p < end && COMP(p - size, p) <= 0)
+                p += size;
+        }
+        n = (p - a) / size;
+        if (n < MINRUN && lo + n < nmemb) {
+            size_t m = min(MINRUN, nmemb - lo);
+            qs22merge_bininsert(a, n, m, size, compar);
+            n = m;
+        }
+        // Merge while the boundary on top is higher than the new one.
+        int pw = 0;
+        if (top) {
+            pw = power(stack[top - 1].start, stack[top - 1].n, n, nmemb);
+            while (top > 1 && stack[top - 1].power > pw) {
+                qs22merge(base + stack[top - 2].start * size, stack[top - 2].n,
+                        stack[top - 1].n, size, compar, &s);
+                stack[top - 2].n += stack[top - 1].n;
+                top--;
+            }
+        }
+        stack[top].start = lo;
+        stack[top].n = n;
+        stack[top].power = pw;
+        top++;
+        lo += n;
+    }
+    for (; top > 1; top--) {
+        qs22merge(base + stack[top - 2].start * size, stack[top - 2].n,
+                stack[top - 1].n, size, compar, &s);
+        stack[top - 2].n += stack[top - 1].n;
+    }
+    if (s.buf != stackbuf.c)
+        free(s.buf);
+}
+
+void qsort(void *base, size_t nmemb, size_t size,
+                                     int (*compar)(const void *, const void *))
+{
+#if FIXED_SIZES
+#define FIXEDSIZE(n) case n: qs22run_sort(base, nmemb, n, compar); return;
+    switch (size) {
+        FIXEDSIZE(4)
+        FIXEDSIZE(8)
+        FIXEDSIZE(12)
+        FIXEDSIZE(16)
+        FIXEDSIZE(24)
+        FIXEDSIZE(32)
+    }
+#undef FIXEDSIZE
+#endif
+    qs22run_sort(base, nmemb, size, compar);
+}
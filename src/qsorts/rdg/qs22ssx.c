@@ -0,0 +1,136 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22ssx.c -- small Shell sort, for builds where code size matters more
+// than speed. Compared with qs22ss:
+//
+// - The gaps are Ciura's (GAPS 0, the default; 1, 4, 10, 23, 57, 132, 301,
+//   701, 1750, then times 2.25), Tokuda's (GAPS 1; h = 2.25h + 1, rounded
+//   up) or Sedgewick's 1986 sequence (GAPS 2; 4^k + 3*2^(k-1) + 1 and
+//   9*4^k - 9*2^k + 1), not 3h + 1, from a table so no arithmetic is spent
+//   on them.
+// - An element out of order is copied out, the ones gap apart before it
+//   that are greater are moved up a gap each, and it is copied into the
+//   hole that leaves: one move per step instead of a swap.
+// - The moves are memcpy() calls, which move a word or more at a time.
+// - With NETWORK, the pass with the second gap is replaced by sorting each
+//   block of 8 elements with a 19-comparator network, before the last pass.
+//
+// Elements bigger than HOLEMAXSIZE are moved through the hole a piece at a
+// time.
+//
+#include <stddef.h>
+
+#include "swap.h"
+
+#ifndef GAPS
+#define GAPS            0
+#endif
+#ifndef NETWORK
+#define NETWORK         0
+#endif
+
+#define HOLEMAXSIZE     256
+
+#define  COMP(a, b)  ((*compar)((void *)(a), (void *)(b)))
+
+static const unsigned gaps[] = {
+#if GAPS == 0           // Ciura
+    1, 4, 10, 23, 57, 132, 301, 701, 1750, 3937, 8858, 19930, 44842, 100894,
+    227011, 510774, 1149241, 2585792, 5818032, 13090572, 29453787, 66271020,
+    149109795, 335497038, 754868335, 1698453753, 3821520944u,
+#elif GAPS == 1         // Tokuda
+    1, 4, 9, 20, 46, 103, 233, 525, 1182, 2660, 5985, 13467, 30301, 68178,
+    153401, 345152, 776591, 1747331, 3931496, 8845866, 19903198, 44782196,
+    100759940, 226709866, 510097200, 1147718700, 2582367076u,
+#else                   // Sedgewick
+    1, 5, 19, 41, 109, 209, 505, 929, 2161, 3905, 8929, 16001, 36289, 64769,
+    146305, 260609, 587521, 1045505, 2354689, 4188161, 9427969, 16764929,
+    37730305, 67084289, 150958081, 268386305, 603906049, 1073643521,
+    2415771649u, 4294770689u,
+#endif
+};
+
+// Swap n bytes at a and b through the hole, HOLEMAXSIZE bytes at a time.
+static void swap_hole(char *a, char *b, size_t n, char *hole)
+{
+    for (size_t k; n; n -= k, a += k, b += k) {
+        k = n < HOLEMAXSIZE ? n : HOLEMAXSIZE;
+        swap_copy(hole, a, k);
+        swap_copy(a, b, k);
+        swap_copy(b, hole, k);
+    }
+}
+
+// Insertion sort of base[0..limit) with elements gap bytes apart.
+static void gap_insert(char *base, char *limit, size_t gap, size_t size,
+        int (*compar)(const void *, const void *), char *hole)
+{
+    for (char *i = base + gap; i < limit; i += size) {
+        char *j = i;
+        if (COMP(j - gap, j) <= 0)
+            continue;
+        if (size <= HOLEMAXSIZE) {
+            swap_copy(hole, j, size);
+            do {
+                swap_copy(j, j - gap, size);
+                j -= gap;
+            } while ((size_t)(j - base) >= gap && COMP(j - gap, hole) > 0);
+            swap_copy(j, hole, size);
+        } else {
+            do {
+                swap_hole(j - gap, j, size, hole);
+                j -= gap;
+            } while ((size_t)(j - base) >= gap && COMP(j - gap, j) > 0);
+        }
+    }
+}
+
+#if NETWORK
+// Knuth's 19-comparator network for 8 elements, as pairs of indexes.
+static const unsigned char net8[] = {
+    0x02, 0x13, 0x46, 0x57, 0x04, 0x15, 0x26, 0x37, 0x01, 0x23, 0x45, 0x67,
+    0x24, 0x35, 0x14, 0x36, 0x12, 0x34, 0x56,
+};
+#endif
+
+void qsort(void *base, size_t nmemb, size_t size,
+                                     int (*compar)(const void *, const void *))
+{
+    union { char c[HOLEMAXSIZE]; swap_align_t a; } holebuf;
+    char *hole = holebuf.c, *limit = (char *)base + nmemb * size;
+    const unsigned *g = gaps + sizeof gaps / sizeof gaps[0] - 1;
+
+    while (g > gaps && *g >= nmemb)
+        g--;
+#if NETWORK
+    for (; g > gaps + 1; g--)
+        gap_insert(base, limit, *g * size, size, compar, hole);
+    for (char *b = base; b + 8 * size <= limit; b += 8 * size) {
+        for (size_t k = 0; k < sizeof net8; k++) {
+            char *x = b + (net8[k] >> 4) * size, *y = b + (net8[k] & 15) * size;
+            if (COMP(x, y) > 0)
+                swap_hole(x, y, size, hole);
+        }
+    }
+    gap_insert(base, limit, size, size, compar, hole);
+#else
+    for (;; g--) {
+        gap_insert(base, limit, *g * size, size, compar, hole);
+        if (g == gaps)
+            break;
+    }
+#endif
+}
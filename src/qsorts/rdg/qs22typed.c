@@ -0,0 +1,314 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22typed.c -- qs22j-style quicksort for arrays of plain numeric keys, with
+// no compare callback. Large subfiles are partitioned with AVX2 when the CPU
+// has it (see vpartition() in qs22typed.h), and subfiles of NETMIN to NETSIZE
+// keys are sorted in registers with a bitonic network (netsort()). Otherwise
+// it's all scalar, with insertion sort for small subfiles.
+//
+// Build with -DQS22_AVX2=0 to leave out the AVX2 code.
+//
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "qs22.h"
+
+#ifndef QS22_AVX2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QS22_AVX2 1
+#else
+#define QS22_AVX2 0
+#endif
+#endif
+
+#define INSORTTHRESH    16          // if n < this use insertion sort
+#define MIDTHRESH       20          // < this use middle as pivot
+#define MEDOF3THRESH    50          // < this use median-of-3 as pivot
+                                    // larger subfiles use med-of-3-medians
+#define VPARTTHRESH     128         // >= this, vector partition if AVX2
+#define NETSIZE         32          // <= this, sorting network if AVX2
+#define NETMIN          6           // >= this, sorting network if AVX2
+
+#if QS22_AVX2
+#include <immintrin.h>
+
+// Lane permutations for VPERM(), indexed by the mask of lanes that go right.
+// Each entry is eight 3-bit lane indices for _mm256_permutevar8x32_epi32(),
+// one per nibble, lowest nibble first.
+static const uint32_t perm32[256] = {
+    0x76543210, 0x07654321, 0x17654320, 0x10765432, 0x27654310, 0x20765431,
+    0x21765430, 0x21076543, 0x37654210, 0x30765421, 0x31765420, 0x31076542,
+    0x32765410, 0x32076541, 0x32176540, 0x32107654, 0x47653210, 0x40765321,
+    0x41765320, 0x41076532, 0x42765310, 0x42076531, 0x42176530, 0x42107653,
+    0x43765210, 0x43076521, 0x43176520, 0x43107652, 0x43276510, 0x43207651,
+    0x43217650, 0x43210765, 0x57643210, 0x50764321, 0x51764320, 0x51076432,
+    0x52764310, 0x52076431, 0x52176430, 0x52107643, 0x53764210, 0x53076421,
+    0x53176420, 0x53107642, 0x53276410, 0x53207641, 0x53217640, 0x53210764,
+    0x54763210, 0x54076321, 0x54176320, 0x54107632, 0x54276310, 0x54207631,
+    0x54217630, 0x54210763, 0x54376210, 0x54307621, 0x54317620, 0x54310762,
+    0x54327610, 0x54320761, 0x54321760, 0x54321076, 0x67543210, 0x60754321,
+    0x61754320, 0x61075432, 0x62754310, 0x62075431, 0x62175430, 0x62107543,
+    0x63754210, 0x63075421, 0x63175420, 0x63107542, 0x63275410, 0x63207541,
+    0x63217540, 0x63210754, 0x64753210, 0x64075321, 0x64175320, 0x64107532,
+    0x64275310, 0x64207531, 0x64217530, 0x64210753, 0x64375210, 0x64307521,
+    0x64317520, 0x64310752, 0x64327510, 0x64320751, 0x64321750, 0x64321075,
+    0x65743210, 0x65074321, 0x65174320, 0x65107432, 0x65274310, 0x65207431,
+    0x65217430, 0x65210743, 0x65374210, 0x65307421, 0x65317420, 0x65310742,
+    0x65327410, 0x65320741, 0x65321740, 0x65321074, 0x65473210, 0x65407321,
+    0x65417320, 0x65410732, 0x65427310, 0x65420731, 0x65421730, 0x65421073,
+    0x65437210, 0x65430721, 0x65431720, 0x65431072, 0x65432710, 0x65432071,
+    0x65432170, 0x65432107, 0x76543210, 0x70654321, 0x71654320, 0x71065432,
+    0x72654310, 0x72065431, 0x72165430, 0x72106543, 0x73654210, 0x73065421,
+    0x73165420, 0x73106542, 0x73265410, 0x73206541, 0x73216540, 0x73210654,
+    0x74653210, 0x74065321, 0x74165320, 0x74106532, 0x74265310, 0x74206531,
+    0x74216530, 0x74210653, 0x74365210, 0x74306521, 0x74316520, 0x74310652,
+    0x74326510, 0x74320651, 0x74321650, 0x74321065, 0x75643210, 0x75064321,
+    0x75164320, 0x75106432, 0x75264310, 0x75206431, 0x75216430, 0x75210643,
+    0x75364210, 0x75306421, 0x75316420, 0x75310642, 0x75326410, 0x75320641,
+    0x75321640, 0x75321064, 0x75463210, 0x75406321, 0x75416320, 0x75410632,
+    0x75426310, 0x75420631, 0x75421630, 0x75421063, 0x75436210, 0x75430621,
+    0x75431620, 0x75431062, 0x75432610, 0x75432061, 0x75432160, 0x75432106,
+    0x76543210, 0x76054321, 0x76154320, 0x76105432, 0x76254310, 0x76205431,
+    0x76215430, 0x76210543, 0x76354210, 0x76305421, 0x76315420, 0x76310542,
+    0x76325410, 0x76320541, 0x76321540, 0x76321054, 0x76453210, 0x76405321,
+    0x76415320, 0x76410532, 0x76425310, 0x76420531, 0x76421530, 0x76421053,
+    0x76435210, 0x76430521, 0x76431520, 0x76431052, 0x76432510, 0x76432051,
+    0x76432150, 0x76432105, 0x76543210, 0x76504321, 0x76514320, 0x76510432,
+    0x76524310, 0x76520431, 0x76521430, 0x76521043, 0x76534210, 0x76530421,
+    0x76531420, 0x76531042, 0x76532410, 0x76532041, 0x76532140, 0x76532104,
+    0x76543210, 0x76540321, 0x76541320, 0x76541032, 0x76542310, 0x76542031,
+    0x76542130, 0x76542103, 0x76543210, 0x76543021, 0x76543120, 0x76543102,
+    0x76543210, 0x76543201, 0x76543210, 0x76543210,
+};
+
+// The same for 64-bit lanes: each lane is a pair of 32-bit lanes.
+static const uint32_t perm64[16] = {
+    0x76543210, 0x10765432, 0x32765410, 0x32107654, 0x54763210, 0x54107632,
+    0x54327610, 0x54321076, 0x76543210, 0x76105432, 0x76325410, 0x76321054,
+    0x76543210, 0x76541032, 0x76543210, 0x76543210,
+};
+
+__attribute__((target("avx2")))
+static inline __m256i perm_index(uint32_t packed)
+{
+    return _mm256_srlv_epi32(_mm256_set1_epi32(packed),
+            _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28));
+}
+
+static int have_avx2(void)
+{
+    static int have = -1;
+    if (have < 0)
+        have = __builtin_cpu_supports("avx2") ? 1 : 0;
+    return have;
+}
+
+// In-register sorting network steps. CEX(v, x, m) compare-exchanges each
+// lane of v with the lane x(v) puts in its place; lanes in mask m (in units
+// of VBLEND) keep the larger. Sorting 2^k lanes is a bitonic merge for each
+// of the k block sizes, and each merge ends with a bitonic clean (VCLEANR).
+#define CEX(v, x, m) do { VEC w_ = x(v); \
+        v = VBLEND(VMIN(v, w_), VMAX(v, w_), m); } while (0)
+
+// 8 x 32-bit lanes; lane i is swapped with lane i ^ 1, 2, 3, 4 or 7.
+#define X1_8(v) _mm256_shuffle_epi32(v, 0xB1)
+#define X2_8(v) _mm256_shuffle_epi32(v, 0x4E)
+#define X3_8(v) _mm256_shuffle_epi32(v, 0x1B)
+#define X4_8(v) _mm256_permute2x128_si256(v, v, 1)
+#define X7_8(v) _mm256_permutevar8x32_epi32(v, \
+        _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0))
+#define VSORT8(v) do { CEX(v, X1_8, 0xAA); \
+        CEX(v, X3_8, 0xCC); CEX(v, X1_8, 0xAA); \
+        CEX(v, X7_8, 0xF0); CEX(v, X2_8, 0xCC); CEX(v, X1_8, 0xAA); } while (0)
+#define VCLEAN8(v) do { CEX(v, X4_8, 0xF0); \
+        CEX(v, X2_8, 0xCC); CEX(v, X1_8, 0xAA); } while (0)
+
+// 4 x 64-bit integer lanes; lane i is swapped with lane i ^ 1, 2 or 3.
+// Masks are for _mm256_blend_epi32(), two bits per lane.
+#define X1_4(v) _mm256_shuffle_epi32(v, 0x4E)
+#define X2_4(v) _mm256_permute2x128_si256(v, v, 1)
+#define X3_4(v) _mm256_permute4x64_epi64(v, 0x1B)
+#define VSORT4(v) do { CEX(v, X1_4, 0xCC); \
+        CEX(v, X3_4, 0xF0); CEX(v, X1_4, 0xCC); } while (0)
+#define VCLEAN4(v) do { CEX(v, X2_4, 0xF0); CEX(v, X1_4, 0xCC); } while (0)
+
+// 4 x double lanes, for _mm256_blend_pd().
+#define X1_4D(v) _mm256_permute_pd(v, 0x5)
+#define X2_4D(v) _mm256_permute2f128_pd(v, v, 1)
+#define X3_4D(v) _mm256_permute4x64_pd(v, 0x1B)
+#define VSORT4D(v) do { CEX(v, X1_4D, 0xA); \
+        CEX(v, X3_4D, 0xC); CEX(v, X1_4D, 0xA); } while (0)
+#define VCLEAN4D(v) do { CEX(v, X2_4D, 0xC); CEX(v, X1_4D, 0xA); } while (0)
+#else
+#define have_avx2() 0
+#endif
+
+#define VAR int32_t
+#define FUNC(NAME) NAME##_i32
+#define LESS(a, b) ((a) < (b))
+#define LANES 8
+#define VEC __m256i
+#define VLOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+#define VSTORE(p, v) _mm256_storeu_si256((__m256i *)(p), v)
+#define VSET1(x) _mm256_set1_epi32(x)
+#define VGTMASK(a, b) \
+    _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b)))
+#define VPERM(v, m) _mm256_permutevar8x32_epi32(v, perm_index(perm32[m]))
+#define MAXVAL INT32_MAX
+#define VMIN(a, b) _mm256_min_epi32(a, b)
+#define VMAX(a, b) _mm256_max_epi32(a, b)
+#define VBLEND(a, b, m) _mm256_blend_epi32(a, b, m)
+#define VSORTR(v) VSORT8(v)
+#define VCLEANR(v) VCLEAN8(v)
+#define VREVR(v) X7_8(v)
+#include "qs22typed.h"
+
+#undef VAR
+#undef FUNC
+#undef VGTMASK
+#undef VSET1
+#undef MAXVAL
+#undef VMIN
+#undef VMAX
+#define VAR uint32_t
+#define FUNC(NAME) NAME##_u32
+#define MAXVAL UINT32_MAX
+#define VMIN(a, b) _mm256_min_epu32(a, b)
+#define VMAX(a, b) _mm256_max_epu32(a, b)
+#define VSET1(x) _mm256_set1_epi32((int32_t)(x))
+#define VGTMASK(a, b) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32( \
+        _mm256_xor_si256(a, _mm256_set1_epi32(INT32_MIN)), \
+        _mm256_xor_si256(b, _mm256_set1_epi32(INT32_MIN)))))
+#include "qs22typed.h"
+
+#undef VAR
+#undef FUNC
+#undef LANES
+#undef VGTMASK
+#undef VSET1
+#undef VPERM
+#undef MAXVAL
+#undef VMIN
+#undef VMAX
+#undef VSORTR
+#undef VCLEANR
+#undef VREVR
+#define VAR int64_t
+#define FUNC(NAME) NAME##_i64
+#define LANES 4
+#define VSET1(x) _mm256_set1_epi64x(x)
+#define VGTMASK(a, b) \
+    _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(a, b)))
+#define VPERM(v, m) _mm256_permutevar8x32_epi32(v, perm_index(perm64[m]))
+#define MAXVAL INT64_MAX
+#define VMIN(a, b) _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b))
+#define VMAX(a, b) _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(b, a))
+#define VSORTR(v) VSORT4(v)
+#define VCLEANR(v) VCLEAN4(v)
+#define VREVR(v) X3_4(v)
+#include "qs22typed.h"
+
+#undef VAR
+#undef FUNC
+#undef VGTMASK
+#undef VSET1
+#undef MAXVAL
+#undef VMIN
+#undef VMAX
+#define VAR uint64_t
+#define FUNC(NAME) NAME##_u64
+#define VSET1(x) _mm256_set1_epi64x((int64_t)(x))
+#define VGTU64(a, b) _mm256_cmpgt_epi64( \
+        _mm256_xor_si256(a, _mm256_set1_epi64x(INT64_MIN)), \
+        _mm256_xor_si256(b, _mm256_set1_epi64x(INT64_MIN)))
+#define VGTMASK(a, b) _mm256_movemask_pd(_mm256_castsi256_pd(VGTU64(a, b)))
+#define MAXVAL UINT64_MAX
+#define VMIN(a, b) _mm256_blendv_epi8(a, b, VGTU64(a, b))
+#define VMAX(a, b) _mm256_blendv_epi8(a, b, VGTU64(b, a))
+#include "qs22typed.h"
+
+#undef VAR
+#undef FUNC
+#undef VEC
+#undef VLOAD
+#undef VSTORE
+#undef VGTMASK
+#undef VSET1
+#undef VPERM
+#undef MAXVAL
+#undef VMIN
+#undef VMAX
+#undef VBLEND
+#undef VSORTR
+#undef VCLEANR
+#undef VREVR
+#define VAR double
+#define FUNC(NAME) NAME##_f64
+#define VEC __m256d
+#define VLOAD(p) _mm256_loadu_pd(p)
+#define VSTORE(p, v) _mm256_storeu_pd(p, v)
+#define VSET1(x) _mm256_set1_pd(x)
+#define VGTMASK(a, b) _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ))
+#define VPERM(v, m) _mm256_castsi256_pd(_mm256_permutevar8x32_epi32( \
+        _mm256_castpd_si256(v), perm_index(perm64[m])))
+#define MAXVAL HUGE_VAL
+// min_pd and max_pd give their second operand when the lanes are equal, as
+// -0.0 and 0.0 are, so the operands are swapped to give the first.
+#define VMIN(a, b) _mm256_min_pd(b, a)
+#define VMAX(a, b) _mm256_max_pd(b, a)
+#define VBLEND(a, b, m) _mm256_blend_pd(a, b, m)
+#define VSORTR(v) VSORT4D(v)
+#define VCLEANR(v) VCLEAN4D(v)
+#define VREVR(v) X3_4D(v)
+#include "qs22typed.h"
+
+void qs22_sort_i32(int32_t *base, size_t nmemb)
+{
+    sort_i32(base, nmemb, have_avx2());
+}
+
+void qs22_sort_i64(int64_t *base, size_t nmemb)
+{
+    sort_i64(base, nmemb, have_avx2());
+}
+
+void qs22_sort_u32(uint32_t *base, size_t nmemb)
+{
+    sort_u32(base, nmemb, have_avx2());
+}
+
+void qs22_sort_u64(uint64_t *base, size_t nmemb)
+{
+    sort_u64(base, nmemb, have_avx2());
+}
+
+// NaNs compare false with everything, so move them to the end first and sort
+// the rest.
+void qs22_sort_f64(double *base, size_t nmemb)
+{
+    size_t n = nmemb;
+    for (size_t k = 0; k < n; ) {
+        if (base[k] != base[k]) {
+            double t = base[k];
+            base[k] = base[--n];
+            base[n] = t;
+        } else {
+            k++;
+        }
+    }
+    sort_f64(base, n, have_avx2());
+}
@@ -0,0 +1,312 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// qs22typed.h -- body of the typed sorts in qs22typed.c, included once per
+// key type (as quadsort.h includes quadsort.c). No include guard.
+//
+// The includer defines:
+//  VAR             the key type
+//  FUNC(NAME)      NAME with a type suffix
+//  LESS(a, b)      a < b for two VAR values
+// and, when QS22_AVX2:
+//  LANES           VARs per 256-bit vector (8 or 4)
+//  VEC             the vector type
+//  VLOAD(p), VSTORE(p, v), VSET1(x)    unaligned load/store, broadcast
+//  VGTMASK(a, b)   bit mask of the lanes where a > b
+//  VPERM(v, m)     v with the lanes clear in m moved to the front and those
+//                  set in m to the back, each in their original order
+//  MAXVAL          the largest VAR, to pad out a sorting network
+//  VMIN(a, b), VMAX(a, b)              lane-wise min and max; where the
+//                  lanes are equal, both give a's (-0.0 and 0.0 are equal)
+//  VSORTR(v)       sort the lanes of v (in place)
+//  VCLEANR(v)      sort the lanes of v if they are bitonic (in place)
+//  VREVR(v)        v with its lanes reversed
+
+static void FUNC(insertion_sort)(VAR *lo, VAR *hi)
+{
+    for (VAR *i = lo + 1; i < hi; i++) {
+        VAR t = *i, *j = i;
+        for ( ; j != lo && LESS(t, j[-1]); j--)
+            *j = j[-1];
+        *j = t;
+    }
+}
+
+static void FUNC(heapsort)(VAR *a, size_t n)
+{
+    for (size_t k = n / 2, m = n; m > 1; ) {
+        VAR t;
+        if (k) {                            // building the heap
+            t = a[--k];
+        } else {                            // taking off the max
+            t = a[--m];
+            a[m] = a[0];
+        }
+        size_t i = k, j;
+        while ((j = 2 * i + 1) < m) {
+            if (j + 1 < m && LESS(a[j], a[j + 1]))
+                j++;
+            if (! LESS(t, a[j]))
+                break;
+            a[i] = a[j];
+            i = j;
+        }
+        a[i] = t;
+    }
+}
+
+static VAR *FUNC(med3)(VAR *a, VAR *b, VAR *c)
+{
+    return LESS(*a, *b) ?
+        (LESS(*b, *c) ? b : LESS(*a, *c) ? c : a) :
+        (LESS(*c, *b) ? b : LESS(*c, *a) ? c : a);
+}
+
+// Partition a[0..n) so that the elements that go left (those < pv, or those
+// <= pv if le) come first. Returns the number that go left.
+static size_t FUNC(spartition)(VAR *a, size_t n, VAR pv, int le)
+{
+    size_t i = 0, j = n;
+    for (;;) {
+        if (le) {
+            while (i < j && ! LESS(pv, a[i]))
+                i++;
+            while (i < j && LESS(pv, a[j - 1]))
+                j--;
+        } else {
+            while (i < j && LESS(a[i], pv))
+                i++;
+            while (i < j && ! LESS(a[j - 1], pv))
+                j--;
+        }
+        if (i >= j)
+            break;
+        VAR t = a[i];
+        a[i++] = a[--j];
+        a[j] = t;
+    }
+    return i;
+}
+
+#if QS22_AVX2
+// Same as spartition(), for n >= 2 * LANES, a vector at a time. The first
+// and last vectors are held in registers, which leaves 2 * LANES free slots
+// between the left and right write pointers. Each vector is read from the
+// side with less free room, its lanes are permuted so the left-going ones
+// come first, and it is stored whole at both write pointers; only the lanes
+// that belong at each end are kept, the rest are written over later.
+__attribute__((target("avx2")))
+static size_t FUNC(vpartition)(VAR *a, size_t n, VAR pv, int le)
+{
+    VEC p = VSET1(pv), v;
+    VAR *rl = a + LANES, *rr = a + n - LANES;   // unread is [rl, rr)
+    VAR *wl = a, *wr = a + n;                   // written [a, wl), [wr, a+n)
+    VEC vl = VLOAD(a), vr = VLOAD(rr);
+    int flip = le ? 0 : (1 << LANES) - 1, m;
+
+#define PARTVEC(v) do { \
+        m = le ? VGTMASK(v, p) : VGTMASK(p, v) ^ flip; \
+        v = VPERM(v, m); \
+        VSTORE(wl, v); \
+        VSTORE(wr - LANES, v); \
+        m = __builtin_popcount(m); \
+        wl += LANES - m; \
+        wr -= m; \
+    } while (0)
+
+    while (rr - rl >= LANES) {
+        if (rl - wl <= wr - rr) {
+            v = VLOAD(rl);
+            rl += LANES;
+        } else {
+            rr -= LANES;
+            v = VLOAD(rr);
+        }
+        PARTVEC(v);
+    }
+    // Fewer than LANES unread; [wl, wr) is all free once they're saved.
+    VAR rest[LANES];
+    size_t nrest = rr - rl;
+    for (size_t k = 0; k < nrest; k++)
+        rest[k] = rl[k];
+    for (size_t k = 0; k < nrest; k++) {
+        if (le ? ! LESS(pv, rest[k]) : LESS(rest[k], pv))
+            *wl++ = rest[k];
+        else
+            *--wr = rest[k];
+    }
+    PARTVEC(vl);
+    PARTVEC(vr);
+#undef PARTVEC
+    return wl - a;
+}
+
+// Bitonic sorting network for the R * LANES keys in r[0..R), R a power of 2
+// and a constant after inlining, so r[] stays in registers. Each vector is
+// sorted in-register, then pairs, then fours. The first step of each merge
+// compares key i with key k - 1 - i of the block being merged (the second
+// half taken in reverse), so every step sorts ascending. VMAX() takes its
+// operands the other way round from VMIN(), so of two equal keys (-0.0 and
+// 0.0) each side gets one.
+__attribute__((target("avx2"), always_inline))
+static inline void FUNC(bitonic)(VEC *r, const int R)
+{
+    for (int i = 0; i < R; i++)
+        VSORTR(r[i]);
+    for (int k = 2; k <= R; k *= 2) {
+        for (int b = 0; b < R; b += k) {
+            for (int i = 0; i < k / 2; i++) {
+                VEC x = r[b + i], y = VREVR(r[b + k - 1 - i]);
+                r[b + i] = VMIN(x, y);
+                r[b + k - 1 - i] = VREVR(VMAX(y, x));
+            }
+        }
+        for (int d = k / 4; d >= 1; d /= 2) {
+            for (int i = 0; i < R; i++) {
+                if (! (i & d)) {
+                    VEC x = r[i], y = r[i + d];
+                    r[i] = VMIN(x, y);
+                    r[i + d] = VMAX(y, x);
+                }
+            }
+        }
+        for (int i = 0; i < R; i++)
+            VCLEANR(r[i]);
+    }
+}
+
+// Sort a[0..n), n <= NETSIZE, with the network. The keys are padded with
+// MAXVAL to fill 1, 2 or 4 vectors.
+__attribute__((target("avx2")))
+static void FUNC(netsort)(VAR *a, size_t n)
+{
+    VAR buf[NETSIZE];
+    VEC r[NETSIZE / LANES];
+    int R = n <= LANES ? 1 : n <= 2 * LANES ? 2 : n <= 4 * LANES ? 4 : 8;
+    size_t k;
+
+    for (k = 0; k < n; k++)
+        buf[k] = a[k];
+    for ( ; k < (size_t)R * LANES; k++)
+        buf[k] = MAXVAL;
+    for (int i = 0; i < R; i++)
+        r[i] = VLOAD(buf + i * LANES);
+    if (R == 1)
+        FUNC(bitonic)(r, 1);
+    else if (R == 2)
+        FUNC(bitonic)(r, 2);
+    else if (R == 4 || NETSIZE / LANES < 8)
+        FUNC(bitonic)(r, 4);
+    else
+        FUNC(bitonic)(r, 8);
+    for (int i = 0; i < R; i++)
+        VSTORE(buf + i * LANES, r[i]);
+    for (k = 0; k < n; k++)
+        a[k] = buf[k];
+}
+#endif
+
+// Quicksort a[0..nmemb), in the manner of qs22j: explicit stack, presorted
+// check, med3 / med3-of-med3s pivot, and introsort depth limit; subfiles of
+// up to NETSIZE keys go to the sorting network (AVX2) or insertion sort. Elements
+// equal to the pivot go right, and when a subfile's pivot equals the element
+// just before it (the pivot that split it off), the elements equal to it are
+// partitioned out to the left and dropped, as in pdqsort.
+static void FUNC(sort)(VAR *base, size_t nmemb, int simd)
+{
+    VAR *stack[2*8*sizeof(size_t)], **sp = stack;
+    int depthstack[8*sizeof(size_t)];
+    int depth = 0, maxdepth = 0;
+    VAR *lo = base, *hi = base + nmemb, *i;
+
+    (void)simd;
+    for (size_t k = nmemb; k > 0; k >>= 1)
+        maxdepth += 2;
+    for (;;) {
+        size_t n = hi - lo;
+        for (i = lo + 1; i < hi && ! LESS(*i, i[-1]); i++)
+            ;
+        if (i >= hi)                        // if already in order
+            goto pop;
+#if QS22_AVX2
+        if (simd && n <= NETSIZE && n >= NETMIN) {
+            FUNC(netsort)(lo, n);
+            goto pop;
+        }
+#endif
+        if (n < INSORTTHRESH) {
+            FUNC(insertion_sort)(lo, hi);
+            goto pop;
+        }
+        if (depth++ >= maxdepth) {          // too deep; use heapsort
+            FUNC(heapsort)(lo, n);
+            goto pop;
+        }
+        VAR *p = lo + n / 2, *right = hi - 1;
+        if (n >= MIDTHRESH) {
+            VAR *pleft = lo + 1, *pright = right - 1;
+            if (n >= MEDOF3THRESH) {
+                size_t k = n / 8;
+                pleft = FUNC(med3)(pleft, lo + k, lo + k * 2);
+                p = FUNC(med3)(p - k, p, p + k);
+                pright = FUNC(med3)(right - k * 2, right - k, pright);
+            }
+            p = FUNC(med3)(pleft, p, pright);
+        }
+        VAR pv = *p;
+        *p = *right;                        // pivot out of the way
+        *right = pv;
+        int le = lo != base && ! LESS(lo[-1], pv);
+        size_t k;
+#if QS22_AVX2
+        if (simd && n - 1 >= VPARTTHRESH)
+            k = FUNC(vpartition)(lo, n - 1, pv, le);
+        else
+#endif
+            k = FUNC(spartition)(lo, n - 1, pv, le);
+        *right = lo[k];                     // pivot to its place
+        lo[k] = pv;
+        if (le) {                           // lo[0..k] all equal pivot
+            lo += k + 1;
+            continue;
+        }
+        VAR *mid = lo + k;
+        if (mid - lo > hi - mid) {          // stack larger part
+            if (mid - lo > 1) {
+                sp[0] = lo;
+                sp[1] = mid;
+                depthstack[(sp - stack) / 2] = depth;
+                sp += 2;
+            }
+            lo = mid + 1;
+        } else {
+            if (hi - mid > 2) {
+                sp[0] = mid + 1;
+                sp[1] = hi;
+                depthstack[(sp - stack) / 2] = depth;
+                sp += 2;
+            }
+            hi = mid;
+        }
+        continue;
+pop:
+        if (sp == stack)
+            break;
+        sp -= 2;
+        lo = sp[0];
+        hi = sp[1];
+        depth = depthstack[(sp - stack) / 2];
+    }
+}
@@ -0,0 +1,165 @@
+//  License: 0BSD
+//
+//  Copyright 2022 Raymond Gardner
+//
+//  Permission to use, copy, modify, and/or distribute this software for any
+//  purpose with or without fee is hereby granted.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+//  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+//  SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+//  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+//  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+//  IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// swap.h -- element swaps and moves shared by the sorts, for any size and
+// alignment. Everything is done in the widest moves available: 32 bytes
+// with AVX2 (if the compiler targets it), 16 with SSE2, else 8, 4, 1. All
+// loads and stores are unaligned (by memcpy() or the loadu/storeu
+// intrinsics), so an unaligned base or an odd size such as 230 costs no
+// byte loop. When the size isn't a multiple of the move width, the last
+// move overlaps the one before it, with its data loaded before anything is
+// stored, so it stays a swap.
+//
+//  swap_elems(a, b, n)     swap n bytes at a and b (inline; with a constant
+//                          n it is a few loads and stores)
+//  swap_func(a, b, n)      the same, as a function, for swap function
+//                          pointers; also swaps whole runs of elements
+//  swap_copy(dst, src, n)  copy n bytes
+//  swap_move(dst, src, n)  copy n bytes; the regions may overlap
+//  swap_align_t            a union member to align a stack buffer that holds
+//                          elements passed to a compare function, as in
+//                          union { char c[256]; swap_align_t a; } hole;
+//
+// Except for swap_move(), the regions must not overlap. With COUNTSWAPS, each
+// adds n to the byte counter, tot_swaps unless the includer defines
+// SWAP_COUNTER to be another.
+//
+#ifndef SWAP_H
+#define SWAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#if COUNTSWAPS
+#ifndef SWAP_COUNTER
+extern unsigned long long tot_swaps;
+#define SWAP_COUNTER    tot_swaps
+#endif
+#define SWAP_COUNT(n)   (SWAP_COUNTER += (n))
+#else
+#define SWAP_COUNT(n)   ((void)0)
+#endif
+
+#define SWAP_INLINE     inline __attribute__((always_inline))
+
+// Aligned as strictly as any element type (max_align_t is C11 only).
+typedef union {
+    long double ld;
+    long long ll;
+    double d;
+    void *p;
+    void (*fp)(void);
+} swap_align_t;
+
+// Swap n bytes a move of type T (width W) at a time, n >= W. The last move
+// is at the end and is loaded first, so it may overlap the others.
+#define SWAP_WIDE(T, W, LOAD, STORE) do { \
+        T ta = LOAD(a + n - W), tb = LOAD(b + n - W), x, y; \
+        for (size_t k = 0; k + W < n; k += W) { \
+            x = LOAD(a + k); \
+            y = LOAD(b + k); \
+            STORE(a + k, y); \
+            STORE(b + k, x); \
+        } \
+        STORE(a + n - W, tb); \
+        STORE(b + n - W, ta); \
+    } while (0)
+
+static SWAP_INLINE uint64_t swap_ld64(const void *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+static SWAP_INLINE void swap_st64(void *p, uint64_t v)
+{
+    memcpy(p, &v, sizeof v);
+}
+
+static SWAP_INLINE uint32_t swap_ld32(const void *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+static SWAP_INLINE void swap_st32(void *p, uint32_t v)
+{
+    memcpy(p, &v, sizeof v);
+}
+
+#if defined(__SSE2__)
+#define swap_ld128(p)       _mm_loadu_si128((const __m128i *)(p))
+#define swap_st128(p, v)    _mm_storeu_si128((__m128i *)(p), v)
+#endif
+#if defined(__AVX2__)
+#define swap_ld256(p)       _mm256_loadu_si256((const __m256i *)(p))
+#define swap_st256(p, v)    _mm256_storeu_si256((__m256i *)(p), v)
+#endif
+
+static SWAP_INLINE void swap_elems(void *a0, void *b0, size_t n)
+{
+    char *a = a0, *b = b0;
+
+    SWAP_COUNT(n);
+#if defined(__AVX2__)
+    if (n >= 32) {
+        SWAP_WIDE(__m256i, 32, swap_ld256, swap_st256);
+        return;
+    }
+#endif
+#if defined(__SSE2__)
+    if (n >= 16) {
+        SWAP_WIDE(__m128i, 16, swap_ld128, swap_st128);
+        return;
+    }
+#endif
+    if (n >= 8) {
+        SWAP_WIDE(uint64_t, 8, swap_ld64, swap_st64);
+    } else if (n >= 4) {
+        SWAP_WIDE(uint32_t, 4, swap_ld32, swap_st32);
+    } else {
+        while (n--) {
+            char t = *a;
+            *a++ = *b;
+            *b++ = t;
+        }
+    }
+}
+
+__attribute__((unused))
+static void swap_func(void *a, void *b, size_t n)
+{
+    swap_elems(a, b, n);
+}
+
+static SWAP_INLINE void swap_copy(void *dst, const void *src, size_t n)
+{
+    SWAP_COUNT(n);
+    memcpy(dst, src, n);
+}
+
+static SWAP_INLINE void swap_move(void *dst, const void *src, size_t n)
+{
+    SWAP_COUNT(n);
+    memmove(dst, src, n);
+}
+
+#endif
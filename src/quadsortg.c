@@ -0,0 +1,3 @@
+#define qsort quadsortg
+
+#include "qsorts/quadsort/quadsortg.c"
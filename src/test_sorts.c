@@ -28,6 +28,8 @@
 #include <unistd.h>
 
 #include "kiss64.h"
+#include "qsorts/rdg/qs22.h"
+#include "qsorts/rdg/qs22_template.h"
 
 
 static char *usage[] = {
@@ -40,26 +42,57 @@ static char *usage[] = {
 "    and https://github.com/izabera/qsortbench by Isabella Bosia.",
 "    Report format modeled on qsortbench.",
 "",
-"Usage: test_sorts [num] [-h -i -d -p -s -z -c]",
+"Usage: test_sorts [num] [-h -i -d -p -u -s -3 -4 -6 -8 -z -c -l -b -M -K -T threads]",
 "    -h  (or --help)  display usage and quit",
 "    num number of elements to sort (default 10000)",
 "    -i  test C int values",
 "    -d  test C double values",
 "    -p  test pointers to strings",
+"    -u  test pointers to strings with a long shared prefix (URLs)",
 "    -s  test array of structs",
+"    -3, -4, -6, -8  test arrays of records of 3, 4, 6 or 8 ints",
 "    -z  run izabera tests",
 "    -c  check for excess compares",
 "    -v  no tests on front or back half reversed",
 "    -m  run small arrays test only (sanity test)",
 "    -r num   number of reps for each test",
+"    -T num   run qs22j_par thread scaling test, 1 to num threads",
+"    -l  time sorts of 2 to 64 elements, qs22j vs. typed sorts",
+"    -b  report qs22j partition balance on random data",
+"    -M  time qs22_merge_inplace() vs. qs22j and qs22run on two sorted runs",
+"    -K  time qs22_kmerge() vs. qs22j on k sorted runs, k = 2 to 1024",
 "",
-"    Default is to test all datatypes on Bentley-McIlroy data patterns.",
-"    One or more of -i, -d, -p, -s may be specified.",
+"    Default is to test -i -d -p -u -s on Bentley-McIlroy data patterns.",
+"    One or more of -i, -d, -p, -u, -s, -3, -4, -6, -8 may be specified.",
+"    -3 to -8 sort 12, 16, 24 or 32 byte records keyed on their first int;",
+"        qs22j has a separately compiled copy for each of these sizes.",
 "    -z runs tests taken from the qsortbench test of Isabella Bosia",
 "        (github.com/izabera), plus a couple of my own.",
 "    -c reports compares in excess of 1.2 n lg n (!!Compares) or",
-"        1.5 n lg n (!!!Compares); lg is log base 2.",
+"        1.5 n lg n (!!!Compares); lg is log base 2. At the end it lists",
+"        each sort's total compares against the lower bound lg(n!).",
 "    -r num will repeat each test on all sorts 'num' times; default 1",
+"    -T num times qs22j_par on random data with 1, 2, 4, ... num threads",
+"        and reports speedup over qs22j. Use a large num elements.",
+"        qs22j_par is run only by -T; it is not in the other tests.",
+"    -l times many sorts of n random ints or doubles for each n from 2 to 64,",
+"        and reports nanoseconds per sort; the typed sorts use sorting",
+"        networks at these sizes. Only -i and -d apply.",
+"    -b sorts num random elements with qs22j and with qs22jn (no pivot",
+"        sample for big subfiles), and reports compares, time, partitions,",
+"        balance (smaller side over all elements partitioned; 0.5 is best)",
+"        and deepest partition. Use a large num, e.g. 10000000.",
+"    -M times qs22_merge_inplace() merging two sorted runs of random keys",
+"        (the second 1/2, 1/10, 1/100 and 1/1000 of num elements) with a",
+"        buffer and without, against sorting them again with qs22j and",
+"        qs22run. Only -i and -d apply.",
+"    -K times qs22_kmerge() and qs22_kmerge_key() merging k = 2, 4, ...",
+"        1024 sorted runs of random keys, num elements in all, against",
+"        sorting them again with qs22j. Only -i and -d apply.",
+"        qs22_kmerge_key() compares keys without calling the compare",
+"        function, so its compares show as 0.",
+"    In the final rankings, sorts that keep records with equal keys in",
+"        their original order (checked before the tests) are marked stable.",
 NULL,
 };
 
@@ -100,6 +133,12 @@ typedef struct {
     UL swaps;
     int time_rank;
     int compares_rank;
+    char *types;        // datatypes it can sort; NULL for any
+    ULL tot_bytes;      // bytes swapped or moved
+    ULL bytes;
+    double tot_bound;   // sum of lg(n!) over the sorts run, for -c
+    int stable;         // passed is_stable()
+    int indirect;       // moves big elements through pointers (qs22j)
 } qstbl;
 
 qsort_t bentley_mcilroy;
@@ -112,6 +151,7 @@ qsort_t illumos;
 qsort_t rg91;
 qsort_t rg91mod;
 qsort_t quadsort;
+qsort_t quadsortg;
 
 qsort_t qs22a;
 qsort_t qs22b;
@@ -122,14 +162,31 @@ qsort_t qs22f;
 qsort_t qs22h;
 qsort_t qs22i;
 qsort_t qs22j;
+qsort_t qs22jd;
+qsort_t qs22jn;
 qsort_t qs22k;
+qsort_t qs22pdq;
+qsort_t qs22mc;
+qsort_t qs22dp;
+qsort_t qs22run;
+qsort_t qs22ism;
+#if ! OS_Windows
+qsort_t qs22j_par;
+extern int qs22j_par_threads;
+#endif
 
 qsort_t rg91ss;
 qsort_t qs22ss;
 qsort_t qs22ssb;
+qsort_t qs22ssx;
+qsort_t qs22ssxt;
+qsort_t qs22ssxs;
+qsort_t qs22ssxn;
 qsort_t qs22heap1;
 qsort_t qs22heap2;
 qsort_t qs22heap3;
+qsort_t qs22heapbu;
+qsort_t qs22heap4;
 qsort_t qs22ydpq;
 
 qsort_t mccaughan;
@@ -174,13 +231,78 @@ qsort_t plan9x;
 qsort_t izabera;
 qsort_t izabera_mini;
 
-#define tblentry(f) {f, #f, 0, 0, 0, 0, 0, 0, 0, 0},
+#define tblentry(f) {f, #f, 0, 0, 0, 0, 0, 0, 0, 0, NULL, 0, 0, 0, 0, 0},
+// For sorts that handle only some datatypes, e.g. "id" for int and double.
+#define tbltyped(f, t) {f, #f, 0, 0, 0, 0, 0, 0, 0, 0, t, 0, 0, 0, 0, 0},
+
+static qsort_t qs22tmpl;     // below, after the compare functions
+
+// Typed sorts behind the qsort() interface. The compare function is not
+// called, so they report no compares.
+static void qs22typed(void *base, size_t nmemb, size_t size,
+        int (*compar)(const void *, const void *))
+{
+    (void)compar;
+    if (size == sizeof(double))
+        qs22_sort_f64(base, nmemb);
+    else
+        qs22_sort_i32(base, nmemb);
+}
+
+static uint64_t key_int(const void *a)
+{
+    return qs22_key_i32(*(const int *)a);
+}
+
+static uint64_t key_double(const void *a)
+{
+    return qs22_key_f64(*(const double *)a);
+}
+
+// qs22_radix_sort() behind the qsort() interface; no compares either.
+static void qs22radix(void *base, size_t nmemb, size_t size,
+        int (*compar)(const void *, const void *))
+{
+    (void)compar;
+    qs22_radix_sort(base, nmemb, size,
+            size == sizeof(double) ? key_double : key_int);
+}
+
+// String sorts behind the qsort() interface, for the 'p' and 'u' datatypes.
+static void qs22afsort(void *base, size_t nmemb, size_t size,
+        int (*compar)(const void *, const void *))
+{
+    (void)size;
+    (void)compar;
+    qs22_afsort_str(base, nmemb);
+}
+
+static void qs22mkqsort(void *base, size_t nmemb, size_t size,
+        int (*compar)(const void *, const void *))
+{
+    (void)size;
+    (void)compar;
+    qs22_mkqsort_str(base, nmemb);
+}
+
+// qs22_resort_tail() behind the qsort() interface: the elements after the
+// longest ordered prefix are the new ones.
+static void qs22tail(void *base, size_t nmemb, size_t size,
+        int (*compar)(const void *, const void *))
+{
+    char *a = base;
+    size_t k = 1;
+    while (k < nmemb && compar(a + (k - 1) * size, a + k * size) <= 0)
+        k++;
+    if (k < nmemb)
+        qs22_resort_tail(base, k, nmemb - k, size, compar);
+}
 
 static qstbl qsorts[] = {
 #if ! OS_Windows
 #if 1
     // Windows qsort can go quadratic
-    {qsort, "system", 0, 0, 0, 0, 0, 0, 0, 0},
+    {qsort, "system", 0, 0, 0, 0, 0, 0, 0, 0, NULL, 0, 0, 0, 0, 0},
 #endif
 #endif
 #if 0
@@ -237,11 +359,30 @@ static qstbl qsorts[] = {
     tblentry(qs22h)
     tblentry(qs22i)
     tblentry(qs22j)
+    tblentry(qs22jd)        // qs22j without indirect mode for big elements
     tblentry(qs22k)
+    tblentry(qs22pdq)       // qs22j plus pdqsort tricks and run detection
+    tblentry(qs22mc)        // QuickMergesort; fewest compares, more moves
+    tblentry(qs22dp)        // dual-pivot quicksort, built like qs22j
+    tblentry(qs22run)       // natural merge sort (powersort); stable
+    tblentry(qs22ism)       // stable block merge sort, no malloc()
+    tblentry(qs22tail)      // qs22_resort_tail() after the ordered prefix
+    tbltyped(qs22tmpl, "idpus") // qs22_template.h: compares inlined
+#endif
+    // qs22j_par is run only by -T: its threads would update tot_compares
+    // through the compare functions without locking.
+#if 1
+    tbltyped(qs22typed, "id")   // qs22_sort_i32 / qs22_sort_f64, AVX2
+    tbltyped(qs22radix, "id")   // qs22_radix_sort, LSD radix on uint64 keys
+    tbltyped(qs22afsort, "pu")  // qs22_afsort_str, MSD radix (American flag)
+    tbltyped(qs22mkqsort, "pu") // qs22_mkqsort_str, multikey quicksort
 #endif
 #if 0
     tblentry(quadsort)
 #endif
+#if 1
+    tblentry(quadsortg)     // quadsort for any element size; stable
+#endif
 #if 1
     tblentry(openbsd)
     tblentry(netbsd)    // netbsd qsort 1.23
@@ -276,6 +417,10 @@ static qstbl qsorts[] = {
 #if 1
     tblentry(qs22ssb)       // Newer Shell sort variant by rdg
     tblentry(qs22ss)        // Newer Shell sort variant by rdg
+    tblentry(qs22ssx)       // small Shell sort, Ciura gaps, hole moves
+    tblentry(qs22ssxt)      // same, Tokuda gaps
+    tblentry(qs22ssxs)      // same, Sedgewick gaps
+    tblentry(qs22ssxn)      // same, Ciura gaps, 8-element network pass
 #endif
 #if 0
     tblentry(rg91ss)        // Old Shell sort variant by rdg
@@ -287,6 +432,8 @@ static qstbl qsorts[] = {
     tblentry(qs22heap1)     // heapsort
     tblentry(qs22heap2)     // heapsort
     tblentry(qs22heap3)     // heapsort
+    tblentry(qs22heapbu)    // bottom-up heapsort; qs22j etc. fall back on it
+    tblentry(qs22heap4)     // bottom-up heapsort, 4-ary heap
 #endif
 #if 1
     tblentry(sortix)        // heapsort -- very slow
@@ -297,19 +444,31 @@ static qstbl qsorts[] = {
 };
 
 ULL tot_swaps;  // This is updated by qsorts modified to count swapped bytes.
+#if COUNTSWAPS
+// Partition balance, updated by qs22j (see run_balance_tests()).
+ULL qs22_parts, qs22_part_elems, qs22_part_smaller;
+int qs22_part_depth;
+#endif
 
 static ULL tot_time;
 static ULL tot_compares;
 
 // datatypes[] must correspond with dtypes[]
-#define maxdatatypes 10     // must be > len(datatypes)
-static char datatypes[] = "idps";   // int, double, ptr to string, struct
+#define maxdatatypes 10     // must be > number of dtypes[]
+// int, double, ptr to string, ptr to string with long prefix, struct;
+// the records of 3, 4, 6, 8 ints in dtypes[] are tested only on request
+static char datatypes[] = "idpus";
 
 static tagged_string_list_t dtypes[] = {
     {'i', "int"},
     {'d', "double"},
     {'p', "stringptr"},
+    {'u', "urlptr"},
     {'s', "struct"},
+    {'3', "rec12"},
+    {'4', "rec16"},
+    {'6', "rec24"},
+    {'8', "rec32"},
     {0, NULL}
     };
 
@@ -448,6 +607,45 @@ static int compare_struct(const void *a, const void *b)
     return strcmp(((stest *)a)->s, ((stest *)b)->s);
 }
 
+// Records of RECWORDS(datatype) ints, '3' to '8'; the first is the key.
+#define RECWORDS(datatype) ((datatype) - '0')
+
+static int compare_rec(const void *a, const void *b)
+{
+    tot_compares++;
+    if (*(const int *)a < *(const int *)b)
+        return -1;
+    else if (*(const int *)a > *(const int *)b)
+        return 1;
+    return 0;
+}
+
+// Sorts made with QS22_DEFINE() for each datatype. Each does the same work
+// per compare as the compare function above for that type, including the
+// count, so against qs22j they show the cost of calling through compar.
+QS22_DEFINE(qs22tmpl_int, int, (tot_compares++, *a < *b))
+QS22_DEFINE(qs22tmpl_double, double, (tot_compares++, *a < *b))
+QS22_DEFINE(qs22tmpl_str, char *,
+        (tot_compares++, xstrrev(*a), xstrrev(*a), strcmp(*a, *b) < 0))
+QS22_DEFINE(qs22tmpl_struct, stest,
+        (tot_compares++, strcmp(a->s, b->s) < 0))
+
+static void qs22tmpl(void *base, size_t nmemb, size_t size,
+        int (*compar)(const void *, const void *))
+{
+    (void)size;
+    if (compar == compare_int)
+        qs22tmpl_int(base, nmemb);
+    else if (compar == compare_double)
+        qs22tmpl_double(base, nmemb);
+    else if (compar == compare_ptr_to_str)
+        qs22tmpl_str(base, nmemb);
+    else if (compar == compare_struct)
+        qs22tmpl_struct(base, nmemb);
+    else
+        abort();
+}
+
 static UL sum(int *v, size_t n)
 {
     UL tot = 0;
@@ -469,6 +667,82 @@ static int is_sorted(int *v, size_t n) {
     return 1;
 }
 
+// Stability check: records of a key and their original position, keyed on
+// the key only. A sort is stable if records with equal keys stay in their
+// original order. Few distinct keys, and arrays big enough that the
+// quicksorts partition rather than just insertion sort them.
+typedef struct {int key; int pos;} stable_rec;
+
+static int compare_stable_rec(const void *a, const void *b)
+{
+    int x = ((const stable_rec *)a)->key, y = ((const stable_rec *)b)->key;
+    return (x > y) - (x < y);
+}
+
+static int is_stable(qsort_t *func)
+{
+    static const size_t sizes[] = {50, 300, 2000};
+    static const int nkeys[] = {2, 10, 100};
+    stable_rec *r = mcalloc(2000, sizeof *r);
+    int ok = 1;
+
+    seed_random31();
+    for (int i = 0; ok && i < 3; i++) {
+        for (int k = 0; ok && k < 3; k++) {
+            size_t n = sizes[i];
+            for (size_t j = 0; j < n; j++) {
+                r[j].key = random31() % nkeys[k];
+                r[j].pos = (int)j;
+            }
+            func(r, n, sizeof *r, compare_stable_rec);
+            for (size_t j = 1; j < n; j++)
+                if (r[j-1].key > r[j].key ||
+                        (r[j-1].key == r[j].key && r[j-1].pos > r[j].pos))
+                    ok = 0;
+        }
+    }
+    free(r);
+    return ok;
+}
+
+// Check a sort of doubles on keys with many duplicates, among them -0.0 and
+// 0.0, which compare equal but are not the same: the output must be in order
+// and hold each value (and each zero) as often as the input did.
+static void check_signed_zeros(qstbl *q)
+{
+    static const double vals[] = {-0.0, 0.0, -1.0, 1.0, 2.5};
+    static const size_t sizes[] = {2, 5, 6, 8, 16, 31, 64, 200, 2000};
+    double *a = mcalloc(2000, sizeof *a);
+    ULL compares = tot_compares;
+
+    seed_random31();
+    for (size_t i = 0; i < sizeof sizes / sizeof sizes[0]; i++) {
+        for (int rep = 0; rep < 20; rep++) {
+            size_t n = sizes[i], count[5] = {0};
+            for (size_t j = 0; j < n; j++) {
+                int k = random31() % 5;
+                a[j] = vals[k];
+                count[k]++;
+            }
+            q->func(a, n, sizeof *a, compare_double);
+            for (size_t j = 0; j < n; j++) {
+                int k = 0;
+                while (k < 5 && (a[j] != vals[k] ||
+                        !signbit(a[j]) != !signbit(vals[k])))
+                    k++;
+                assert(k < 5);
+                count[k]--;
+                if (j)
+                    assert(a[j - 1] <= a[j]);
+            }
+            for (int k = 0; k < 5; k++)
+                assert(count[k] == 0);
+        }
+    }
+    tot_compares = compares;
+    free(a);
+}
+
 #if 0
 static void showtime(ticks_t nticks)
 {
@@ -553,6 +827,9 @@ static int *dither(int *x, size_t n)
     return v;
 }
 
+// Shared by all the 'u' strings; the number follows it.
+#define URLPREFIX   "https://www.example.com/archive/records/2022/02/item-"
+
 static void sort_data(qstbl *q, int *data, size_t n, int datatype,
         int distribution, int modification, int modulus,
         int check_excess_compares)
@@ -565,6 +842,8 @@ printf("Running sort %s on %lld elements (type %c) distro %c modif %c mod %lld\n
     double *ddata = NULL;
     char **pdata = NULL;
     stest *sdata = NULL;
+    int *rdata = NULL;
+    size_t w = RECWORDS(datatype);
     switch (datatype) {
         case 'i':
             break;
@@ -580,12 +859,30 @@ printf("Running sort %s on %lld elements (type %c) distro %c modif %c mod %lld\n
                 sprintf(pdata[kk], "%12.12d", data[kk]);
             }
             break;
+        case 'u':
+            pdata = mcalloc(n, sizeof *pdata);
+            for (size_t kk = 0; kk < n; kk++) {
+                pdata[kk] = mcalloc(sizeof URLPREFIX + 20, 1);
+                sprintf(pdata[kk], URLPREFIX "%12.12d", data[kk]);
+            }
+            break;
         case 's':
             sdata = mcalloc(n, sizeof(*sdata));
             for (size_t kk = 0; kk < n; kk++) {
                 sprintf(sdata[kk].s, "%12.12d", data[kk]);
             }
             break;
+        case '3':
+        case '4':
+        case '6':
+        case '8':
+            // The rest of each record is filled from the key, and checked
+            // after the sort, so a record split up by a bad move shows up.
+            rdata = mcalloc(n, w * sizeof *rdata);
+            for (size_t kk = 0; kk < n; kk++)
+                for (size_t k = 0; k < w; k++)
+                    rdata[kk * w + k] = data[kk] ^ (int)k;
+            break;
     }
     ULL test_compares = tot_compares;
     ticks_t nticks = get_ticks();
@@ -609,6 +906,15 @@ printf("Running sort %s on %lld elements (type %c) distro %c modif %c mod %lld\n
             }
             free(pdata);
             break;
+        case 'u':
+            q->func(pdata, n, sizeof *pdata, compare_ptr_to_str);
+            nticks = get_ticks() - nticks;
+            for (size_t kk = 0; kk < n; kk++) {
+                data[kk] = strtoul(pdata[kk] + sizeof URLPREFIX - 1, NULL, 10);
+                free(pdata[kk]);
+            }
+            free(pdata);
+            break;
         case 's':
             q->func(sdata, n, sizeof *sdata, compare_struct);
             nticks = get_ticks() - nticks;
@@ -617,12 +923,26 @@ printf("Running sort %s on %lld elements (type %c) distro %c modif %c mod %lld\n
             }
             free(sdata);
             break;
+        case '3':
+        case '4':
+        case '6':
+        case '8':
+            q->func(rdata, n, w * sizeof *rdata, compare_rec);
+            nticks = get_ticks() - nticks;
+            for (size_t kk = 0; kk < n; kk++) {
+                data[kk] = rdata[kk * w];
+                for (size_t k = 1; k < w; k++)
+                    assert(rdata[kk * w + k] == (data[kk] ^ (int)k));
+            }
+            free(rdata);
+            break;
     }
     tot_time += nticks;
     test_compares = tot_compares - test_compares;
     assert(is_sorted(data, n));
     assert(sum(data, n) == cksum);
     if (check_excess_compares) {
+        q->tot_bound += lgamma(n + 1.0) / log(2);
         if (test_compares > 1.5 * n * log(n) / log(2))
             printf("!!!Compares: running sort %s on %lld elements (type %c)"
                     " distro %c modif %c mod %lld %lld %5.3g\n",
@@ -656,6 +976,9 @@ static tagged_string_list_t iztests[] = {
     {'g', "pipe_organ"},
     {'x', "push_front"},
     {'y', "push_middle"},
+    {'k', "sorted_plus_0.1%"},  // sorted, then n/1000 random appended
+    {'l', "sorted_plus_1%"},
+    {'m', "sorted_plus_10%"},
 #if ! NO_REVERSE_HALF
     {'z', "reverse_front"},     // Added by Ray G
     {'b', "reverse_back"},      // Added by Ray G
@@ -760,6 +1083,19 @@ static void run_izabera_tests(qstbl *q, int *x, size_t n, int datatype,
                 x[i] = i + 1;
             x[n - 1] = n / 2;
             break;
+        // Sorted, then k = n/1000, n/100 or n/10 random keys appended, as
+        // when new elements are added to a sorted array (qs22_resort_tail).
+        case 'k':
+        case 'l':
+        case 'm': {
+            size_t k = n / (distribution == 'k' ? 1000 :
+                    distribution == 'l' ? 100 : 10);
+            for (size_t i = 0; i < n - k; i++)
+                x[i] = i;
+            for (size_t i = n - k; i < n; i++)
+                x[i] = random31() % (n + 1);
+            break;
+        }
         case 'z':
             for (size_t i = 0; i < n / 2; i++)
                 x[i] = n / 2 - 1 - i;
@@ -890,13 +1226,18 @@ static void test_sort(qstbl *q, int datatype, int use_izabera_tests,
         free(x);
     }
     // Adjust tot_swaps (which is now number of bytes swapped) to actual number
-    // of swaps.
+    // of swaps. A sort that moves elements indirectly (qs22j on 's') also
+    // swaps pointers, so that is rounded down to whole element swaps; any
+    // other sort must move whole elements.
     size_t datasize = datatype == 'i' ? sizeof(int)
         : datatype == 'd' ? sizeof(double)
         : datatype == 'p' ? sizeof(char *)
+        : datatype == 'u' ? sizeof(char *)
         : datatype == 's' ? sizeof(stest)
-        : 0;
-    assert(tot_swaps % datasize == 0);
+        : RECWORDS(datatype) * sizeof(int);
+    assert(tot_swaps % datasize == 0 || (q->indirect && datatype == 's'));
+    q->tot_bytes += tot_swaps;
+    q->bytes += tot_swaps;
     tot_swaps /= datasize;
     q->tot_time += tot_time;
     q->time += tot_time;
@@ -919,6 +1260,28 @@ static int compare_compares(const void *a, const void *b)
     return 1;
 }
 
+static int compare_bytes(const void *a, const void *b)
+{
+    qstbl *aa = *(qstbl **)a, *bb = *(qstbl **)b;
+    if (aa->bytes < bb->bytes)
+        return -1;
+    if (aa->bytes > bb->bytes)
+        return 1;
+    return strcmp(aa->name, bb->name);
+}
+
+static int compare_bound(const void *a, const void *b)
+{
+    qstbl *aa = *(qstbl **)a, *bb = *(qstbl **)b;
+    double ra = aa->tot_compares / aa->tot_bound;
+    double rb = bb->tot_compares / bb->tot_bound;
+    if (ra < rb)
+        return -1;
+    if (ra > rb)
+        return 1;
+    return strcmp(aa->name, bb->name);
+}
+
 static int compare_times(const void *a, const void *b)
 {
     qstbl *aa = *(qstbl **)a, *bb = *(qstbl **)b;
@@ -963,6 +1326,11 @@ static int compare_compares_rank(const void *a, const void *b)
     return strcmp(aa->name, bb->name);
 }
 
+static int sorts_type(qstbl *q, int datatype)
+{
+    return ! q->types || strchr(q->types, datatype);
+}
+
 static void run_tests(char *test_datatypes, size_t num, int use_izabera_tests,
         int check_excess_compares, int opt_no_half_reversed,
         int opt_small_arrays, int nreps)
@@ -978,8 +1346,17 @@ static void run_tests(char *test_datatypes, size_t num, int use_izabera_tests,
         qsorts[i].time = 0;
         qsorts[i].compares = 0;
         qsorts[i].swaps = 0;
+        qsorts[i].tot_bytes = 0;
+        qsorts[i].bytes = 0;
+        qsorts[i].tot_bound = 0;
         qsorts[i].compares_rank = 0;
         qsorts[i].time_rank = 0;
+        // Typed sorts can't sort the records the check uses.
+        qsorts[i].stable = ! qsorts[i].types && is_stable(qsorts[i].func);
+        qsorts[i].indirect = qsorts[i].func == qs22j
+            || qsorts[i].func == qs22tail;
+        if (strchr(test_datatypes, 'd') && sorts_type(&qsorts[i], 'd'))
+            check_signed_zeros(&qsorts[i]);
     }
     printf("%lu elements %d sorts\n", (UL)num, num_sorts);
     for (int dt = 0; dtypes[dt].t; dt++) {
@@ -1002,19 +1379,28 @@ static void run_tests(char *test_datatypes, size_t num, int use_izabera_tests,
                     qsorts[i].time = 0;
                     qsorts[i].compares = 0;
                     qsorts[i].swaps = 0;
+                    qsorts[i].bytes = 0;
                 }
                 for (int repcnt = 0; repcnt < nreps; repcnt++) {
                     for (int qn = 0; qn < num_sorts; qn++) {
+                        if (! sorts_type(&qsorts[qn], dtypes[dt].t))
+                            continue;
                         test_sort(&qsorts[qn], dtypes[dt].t, use_izabera_tests,
                             tests_set[dp].t, modifs[mt].t, num,
                             check_excess_compares, opt_small_arrays);
                     }
                 }
-                // Report on one data distribution.
-                qsort(qq, num_sorts, sizeof(qstbl *), compare_times);
-                for (int i = 0; i < num_sorts; i++) {
+                // Report on one data distribution, for the sorts that ran.
+                int nq = 0;
+                for (int i = 0; i < num_sorts; i++)
+                    if (sorts_type(&qsorts[i], dtypes[dt].t))
+                        qq[nq++] = &qsorts[i];
+                qsort(qq, nq, sizeof(qstbl *), compare_times);
+                for (int i = 0; i < nq; i++) {
 #if COUNTSWAPS
                     printf("%12lu ", qq[i]->swaps);
+                    if (dtypes[dt].t == 's')
+                        printf("%14llu ", qq[i]->bytes);
 #endif
                     printf("%12lu ", qq[i]->compares);
                     showtime(qq[i]->time);
@@ -1023,9 +1409,9 @@ static void run_tests(char *test_datatypes, size_t num, int use_izabera_tests,
                 }
 
                 printf("Comps:");
-                qsort(qq, num_sorts, sizeof(qstbl *), compare_compares);
+                qsort(qq, nq, sizeof(qstbl *), compare_compares);
                 // rank update handles ties.
-                for (int rank = 1, i = 0; i < num_sorts; i++) {
+                for (int rank = 1, i = 0; i < nq; i++) {
                     if (i && qq[i]->compares != qq[i-1]->compares)
                         rank = i+1;
                     printf(" %d. %s", rank, qq[i]->name);
@@ -1033,58 +1419,512 @@ static void run_tests(char *test_datatypes, size_t num, int use_izabera_tests,
                 }
                 printf("\n");
                 printf("Times:");
-                qsort(qq, num_sorts, sizeof(qstbl *), compare_times);
-                for (int rank = 1, i = 0; i < num_sorts; i++) {
+                qsort(qq, nq, sizeof(qstbl *), compare_times);
+                for (int rank = 1, i = 0; i < nq; i++) {
                     if (i && qq[i]->time != qq[i-1]->time)
                         rank = i+1;
                     printf(" %d. %s", rank, qq[i]->name);
                     qq[i]->time_rank += rank;
                 }
                 printf("\n");
+#if COUNTSWAPS
+                // Big elements: rank the sorts that count swaps on bytes
+                // swapped or moved.
+                if (dtypes[dt].t == 's') {
+                    printf("Moves:");
+                    qsort(qq, nq, sizeof(qstbl *), compare_bytes);
+                    int z = 0;          // sorts that don't count come first
+                    while (z < nq && ! qq[z]->bytes)
+                        z++;
+                    for (int rank = 1, i = z; i < nq; i++) {
+                        if (i > z && qq[i]->bytes != qq[i-1]->bytes)
+                            rank = i-z+1;
+                        printf(" %d. %s", rank, qq[i]->name);
+                    }
+                    printf("\n");
+                }
+#endif
                 if (use_izabera_tests)
                     break;
             }
         }
     }
 
-    // Final summary report
-    qsort(qq, num_sorts, sizeof(qstbl *), compare_compares_rank);
+    // Final summary report. Sorts that ran on only some datatypes are left
+    // out of the rankings and listed after them.
+    int ng = 0, nt = 0;
+    for (int i = 0; i < num_sorts; i++)
+        if (! qsorts[i].types)
+            qq[ng++] = &qsorts[i];
+    for (int i = 0; i < num_sorts; i++)
+        if (qsorts[i].types)
+            qq[ng + nt++] = &qsorts[i];
+    qsort(qq, ng, sizeof(qstbl *), compare_compares_rank);
     printf("Best by rankings on compares:\n");
 #if COUNTSWAPS
     printf("   Tot.rank     Swaps     Compares      Time   Ratio Implementation\n");
 #else
     printf("   Tot.rank  Compares      Time   Ratio Implementation\n");
 #endif
-    for (int i = 0; i < num_sorts; i++) {
+    for (int i = 0; i < ng; i++) {
         printf("%2d. %4d", i + 1, qq[i]->compares_rank);
 #if COUNTSWAPS
         printf(" %12llu", qq[i]->tot_swaps);
 #endif
         printf(" %12llu", qq[i]->tot_compares);
         showtime(qq[i]->tot_time);
-        printf(" %6.3f %s\n",
+        printf(" %6.3f %s%s\n",
                 (double)qq[i]->tot_compares / qq[0]->tot_compares,
-                qq[i]->name);
+                qq[i]->name, qq[i]->stable ? " (stable)" : "");
     }
 
-    qsort(qq, num_sorts, sizeof(qstbl *), compare_time_rank);
+    qsort(qq, ng, sizeof(qstbl *), compare_time_rank);
     printf("Best by rankings on time:\n");
 #if COUNTSWAPS
     printf("   Tot.rank     Swaps     Compares      Time   Ratio Implementation\n");
 #else
     printf("   Tot.rank  Compares      Time   Ratio Implementation\n");
 #endif
-    for (int i = 0; i < num_sorts; i++) {
+    for (int i = 0; i < ng; i++) {
         printf("%2d. %4d", i + 1, qq[i]->time_rank);
 #if COUNTSWAPS
         printf(" %12llu", qq[i]->tot_swaps);
 #endif
         printf(" %12llu", qq[i]->tot_compares);
         showtime(qq[i]->tot_time);
-        printf(" %6.3f %s\n",
+        printf(" %6.3f %s%s\n",
                 (double)qq[i]->tot_time / qq[0]->tot_time,
-                qq[i]->name);
+                qq[i]->name, qq[i]->stable ? " (stable)" : "");
+    }
+
+    if (nt)
+        printf("Not ranked (run on some datatypes only):\n");
+    for (int i = ng; i < ng + nt; i++) {
+        printf("        ");
+#if COUNTSWAPS
+        printf(" %12llu", qq[i]->tot_swaps);
+#endif
+        printf(" %12llu", qq[i]->tot_compares);
+        showtime(qq[i]->tot_time);
+        printf("        %s (%s)\n", qq[i]->name, qq[i]->types);
+    }
+
+    // With -c, how close each sort's compares come to lg(n!), the fewest
+    // any compare sort can average on n distinct keys. Data with runs or
+    // duplicates can be sorted in fewer, so a ratio below 1 is possible.
+    if (check_excess_compares) {
+        int nb = 0;
+        for (int i = 0; i < ng + nt; i++)
+            if (qq[i]->tot_compares && qq[i]->tot_bound > 0)
+                qq[nb++] = qq[i];
+        qsort(qq, nb, sizeof(qstbl *), compare_bound);
+        printf("Compares vs. lower bound lg(n!):\n");
+        printf("       Compares        Bound   Ratio Implementation\n");
+        for (int i = 0; i < nb; i++)
+            printf("%2d. %12llu %12.0f %7.4f %s\n", i + 1,
+                    qq[i]->tot_compares, qq[i]->tot_bound,
+                    qq[i]->tot_compares / qq[i]->tot_bound, qq[i]->name);
+    }
+}
+
+#if ! OS_Windows
+// Time qs22j_par with 1, 2, 4, ... maxthreads threads against qs22j.
+static void run_thread_tests(char *test_datatypes, size_t num, int maxthreads,
+        int nreps)
+{
+    qstbl serial = {qs22j, "qs22j", 0, 0, 0, 0, 0, 0, 0, 0, NULL,
+            0, 0, 0, 0, 0};
+    qstbl par = {qs22j_par, "qs22j_par", 0, 0, 0, 0, 0, 0, 0, 0, NULL,
+            0, 0, 0, 0, 0};
+    int *x = mcalloc(num + 1, sizeof(int));
+    for (int dt = 0; dtypes[dt].t; dt++) {
+        if (! strchr(test_datatypes, dtypes[dt].t))
+            continue;
+        printf("Testing %lu %s elements random (thread scaling):\n", (UL)num,
+                dtypes[dt].str);
+        tot_time = 0;
+        for (int repcnt = 0; repcnt < nreps; repcnt++)
+            run_izabera_tests(&serial, x, num, dtypes[dt].t, 'r', 0);
+        ULL serial_time = tot_time;
+        printf("        ");
+        showtime(serial_time);
+        printf("  1.000 %s\n", serial.name);
+        for (int t = 1; ; t = min(t * 2, maxthreads)) {
+            qs22j_par_threads = t;
+            tot_time = 0;
+            for (int repcnt = 0; repcnt < nreps; repcnt++)
+                run_izabera_tests(&par, x, num, dtypes[dt].t, 'r', 0);
+            printf("%3d thr ", t);
+            showtime(tot_time);
+            printf(" %6.3f %s\n", (double)serial_time / tot_time, par.name);
+            if (t >= maxthreads)
+                break;
+        }
+    }
+    qs22j_par_threads = 0;
+    free(x);
+}
+#endif
+
+#if COUNTSWAPS
+// Partition balance of qs22j on random data, against qs22jn, which is qs22j
+// without the pivot sample for big subfiles. Balance is the elements on the
+// smaller side of each partition over all the elements partitioned, so 0.5
+// is perfect; depth is the deepest partition.
+static void run_balance_tests(char *test_datatypes, size_t num, int nreps)
+{
+    qstbl q[2] = {
+        {qs22jn, "qs22jn", 0, 0, 0, 0, 0, 0, 0, 0, NULL, 0, 0, 0, 0, 0},
+        {qs22j, "qs22j", 0, 0, 0, 0, 0, 0, 0, 0, NULL, 0, 0, 0, 0, 0},
+    };
+    int *x = mcalloc(num + 1, sizeof(int));
+    for (int dt = 0; dtypes[dt].t; dt++) {
+        if (! strchr(test_datatypes, dtypes[dt].t))
+            continue;
+        printf("Testing %lu %s elements random (partition balance):\n",
+                (UL)num, dtypes[dt].str);
+        printf("    Compares      Time   Ratio  Partitions  Balance Depth"
+                " Implementation\n");
+        ULL time0 = 0;
+        for (int k = 0; k < 2; k++) {
+            tot_compares = tot_time = 0;
+            qs22_parts = qs22_part_elems = qs22_part_smaller = 0;
+            qs22_part_depth = 0;
+            for (int repcnt = 0; repcnt < nreps; repcnt++)
+                run_izabera_tests(&q[k], x, num, dtypes[dt].t, 'r', 0);
+            if (k == 0)
+                time0 = tot_time;
+            printf("%12llu", tot_compares / nreps);
+            showtime(tot_time / nreps);
+            printf(" %6.3f %11llu %8.4f %5d %s\n",
+                    (double)tot_time / time0, qs22_parts / nreps,
+                    qs22_part_elems ?
+                    (double)qs22_part_smaller / qs22_part_elems : 0.0,
+                    qs22_part_depth, q[k].name);
+        }
+    }
+    free(x);
+}
+#endif
+
+// Time qs22j against the typed sorts on small arrays, where the typed sorts
+// use sorting networks. Each n is run on a pool of about LATKEYS keys cut
+// into arrays of n.
+#define LATKEYS     (1 << 16)
+static void run_latency_tests(char *test_datatypes, int nreps)
+{
+    int *x = mcalloc(LATKEYS, sizeof(int));
+    int *xi = mcalloc(LATKEYS, sizeof(int));
+    double *xd = mcalloc(LATKEYS, sizeof(double));
+    for (int dt = 0; dtypes[dt].t; dt++) {
+        int t = dtypes[dt].t;
+        if (! strchr(test_datatypes, t) || (t != 'i' && t != 'd'))
+            continue;
+        size_t size = t == 'i' ? sizeof(int) : sizeof(double);
+        char *data = t == 'i' ? (char *)xi : (char *)xd;
+        int (*compar)(const void *, const void *) =
+            t == 'i' ? compare_int : compare_double;
+        printf("Testing %s sort latency (ns per sort):\n", dtypes[dt].str);
+        printf("   n      qs22j  qs22typed  ratio\n");
+        seed_random31();
+        for (size_t i = 0; i < LATKEYS; i++)
+            x[i] = random31();
+        for (size_t n = 2; n <= 64; n++) {
+            size_t narrays = LATKEYS / n;
+            ticks_t nticks[2] = {0, 0};
+            for (int repcnt = -1; repcnt < nreps; repcnt++) {   // -1: warm-up
+                for (int k = 0; k < 2; k++) {
+                    for (size_t i = 0; i < LATKEYS; i++) {
+                        xi[i] = x[i];
+                        xd[i] = x[i];
+                    }
+                    ticks_t start = get_ticks();
+                    for (size_t a = 0; a < narrays; a++) {
+                        if (k == 0)
+                            qs22j(data + a * n * size, n, size, compar);
+                        else
+                            qs22typed(data + a * n * size, n, size, compar);
+                    }
+                    if (repcnt >= 0)
+                        nticks[k] += get_ticks() - start;
+                    for (size_t a = 0; a < narrays; a++) {
+                        if (t == 'i')
+                            assert(is_sorted(xi + a * n, n));
+                        else
+                            for (size_t i = a * n + 1; i < (a + 1) * n; i++)
+                                assert(xd[i - 1] <= xd[i]);
+                    }
+                }
+            }
+            double ns[2];
+            for (int k = 0; k < 2; k++)
+                ns[k] = (double)nticks[k] * 1e9 / ticks_per_second
+                    / ((double)narrays * nreps);
+            printf("%4lu %10.1f %10.1f %6.3f\n", (UL)n, ns[0], ns[1],
+                    ns[1] / ns[0]);
+        }
+    }
+    free(x);
+    free(xi);
+    free(xd);
+}
+
+// Check that qs22_merge_inplace() is stable: two runs of records with few
+// distinct keys, each in key order and then in order of position, merged
+// with a buffer for the shorter run, a small one, and none. Records with
+// equal keys must stay in order of position, those of the first run first.
+static void check_merge_stable(void)
+{
+    static const size_t sizes[] = {1, 2, 7, 50, 300, 2000};
+    static const int nkeys[] = {1, 3, 50};
+    size_t nsizes = sizeof sizes / sizeof sizes[0];
+    stable_rec *r = mcalloc(4000, sizeof *r);
+    stable_rec *scratch = mcalloc(2000, sizeof *scratch);
+    int *keys = mcalloc(4000, sizeof *keys);
+
+    seed_random31();
+    for (size_t i = 0; i < nsizes * nsizes; i++) {
+        size_t n1 = sizes[i / nsizes], n2 = sizes[i % nsizes];
+        for (int k = 0; k < 3; k++) {
+            for (int buf = 0; buf < 3; buf++) {
+                for (size_t j = 0; j < n1 + n2; j++)
+                    keys[j] = random31() % nkeys[k];
+                qs22j(keys, n1, sizeof *keys, compare_int);
+                qs22j(keys + n1, n2, sizeof *keys, compare_int);
+                for (size_t j = 0; j < n1 + n2; j++) {
+                    r[j].key = keys[j];
+                    r[j].pos = (int)j;
+                }
+                qs22_merge_inplace(r, n1, n2, sizeof *r, compare_stable_rec,
+                        buf == 2 ? NULL : scratch,
+                        buf == 0 ? 2000 * sizeof *r : 3 * sizeof *r);
+                for (size_t j = 1; j < n1 + n2; j++)
+                    assert(r[j-1].key < r[j].key || (r[j-1].key == r[j].key
+                                && r[j-1].pos < r[j].pos));
+            }
+        }
+    }
+    free(r);
+    free(scratch);
+    free(keys);
+}
+
+// Time qs22_merge_inplace() on two sorted runs of random keys, of num - n2
+// and n2 elements, against sorting the whole array again with qs22j or
+// qs22run; the merge has a buffer for the shorter run, or none. Each result
+// must equal the keys sorted once beforehand, so none is lost or added.
+static void run_merge_tests(char *test_datatypes, size_t num, int nreps)
+{
+    static const int tails[] = {2, 10, 100, 1000};  // n2 = num / tails[k]
+    static const char *methods[] = {"qs22j", "qs22run",
+        "qs22_merge_inplace, buffer", "qs22_merge_inplace, no buffer"};
+    int *x = mcalloc(num + 1, sizeof(int));
+    int *xi = mcalloc(num + 1, sizeof(int));
+    double *xd = mcalloc(num + 1, sizeof(double));
+    int *sorted = mcalloc(num + 1, sizeof(int));
+    char *scratch = mcalloc(num / 2 + 1, sizeof(double));
+    check_merge_stable();
+    seed_random31();
+    for (size_t i = 0; i < num; i++)
+        x[i] = sorted[i] = random31();
+    qs22j(sorted, num, sizeof(int), compare_int);
+    for (int dt = 0; dtypes[dt].t; dt++) {
+        int t = dtypes[dt].t;
+        if (! strchr(test_datatypes, t) || (t != 'i' && t != 'd'))
+            continue;
+        size_t size = t == 'i' ? sizeof(int) : sizeof(double);
+        char *data = t == 'i' ? (char *)xi : (char *)xd;
+        int (*compar)(const void *, const void *) =
+            t == 'i' ? compare_int : compare_double;
+        printf("Testing %lu %s elements, two sorted runs merged:\n",
+                (UL)num, dtypes[dt].str);
+        printf("       n2    Compares      Time   Ratio Method\n");
+        for (size_t k = 0; k < sizeof tails / sizeof tails[0]; k++) {
+            size_t n2 = num / tails[k], n1 = num - n2;
+            ULL compares[4] = {0};
+            ticks_t nticks[4] = {0};
+            for (int repcnt = 0; repcnt < nreps; repcnt++) {
+                for (int m = 0; m < 4; m++) {
+                    for (size_t i = 0; i < num; i++) {
+                        xi[i] = x[i];
+                        xd[i] = x[i];
+                    }
+                    qs22j(data, n1, size, compar);
+                    qs22j(data + n1 * size, n2, size, compar);
+                    tot_compares = 0;
+                    ticks_t start = get_ticks();
+                    if (m == 0)
+                        qs22j(data, num, size, compar);
+                    else if (m == 1)
+                        qs22run(data, num, size, compar);
+                    else
+                        qs22_merge_inplace(data, n1, n2, size, compar,
+                                m == 2 ? scratch : NULL, n2 * size);
+                    nticks[m] += get_ticks() - start;
+                    compares[m] += tot_compares;
+                    for (size_t i = 0; i < num; i++)
+                        assert(t == 'i' ? xi[i] == sorted[i]
+                                : xd[i] == sorted[i]);
+                }
+            }
+            for (int m = 0; m < 4; m++) {
+                printf("%9lu %11llu", (UL)n2, compares[m] / nreps);
+                showtime(nticks[m] / nreps);
+                printf(" %6.3f %s\n", nticks[0] ?
+                        (double)nticks[m] / nticks[0] : 0.0, methods[m]);
+            }
+        }
+    }
+    free(x);
+    free(xi);
+    free(xd);
+    free(sorted);
+    free(scratch);
+}
+
+static uint64_t key_stable_rec(const void *a)
+{
+    return qs22_key_i32(((const stable_rec *)a)->key);
+}
+
+// Check that qs22_kmerge() and qs22_kmerge_key() are stable and lose
+// nothing: k runs (some empty) of records with few distinct keys, each run
+// in key order, positions numbered through the runs in order. The output
+// must hold each position once, in key order, and records with equal keys
+// in order of position, so a tie goes to the lower-numbered run.
+static void check_kmerge_stable(void)
+{
+    static const size_t ks[] = {1, 2, 3, 7, 64, 65, 200};
+    static const int nkeys[] = {1, 3, 50};
+    stable_rec *in = mcalloc(200 * 40, sizeof *in);
+    stable_rec *out = mcalloc(200 * 40, sizeof *out);
+    char *seen = mcalloc(200 * 40, 1);
+    int *keys = mcalloc(40, sizeof *keys);
+    const void **runs = mcalloc(200, sizeof *runs);
+    size_t *counts = mcalloc(200, sizeof *counts);
+
+    seed_random31();
+    for (size_t i = 0; i < sizeof ks / sizeof ks[0]; i++) {
+        for (int k = 0; k < 3; k++) {
+            for (int m = 0; m < 2; m++) {
+                size_t n = 0;
+                for (size_t r = 0; r < ks[i]; r++) {
+                    counts[r] = random31() % 40;
+                    for (size_t j = 0; j < counts[r]; j++)
+                        keys[j] = random31() % nkeys[k];
+                    qs22j(keys, counts[r], sizeof *keys, compare_int);
+                    runs[r] = in + n;
+                    for (size_t j = 0; j < counts[r]; j++, n++) {
+                        in[n].key = keys[j];
+                        in[n].pos = (int)n;
+                    }
+                }
+                if (m == 0)
+                    qs22_kmerge(runs, counts, ks[i], sizeof *in,
+                            compare_stable_rec, out);
+                else
+                    qs22_kmerge_key(runs, counts, ks[i], sizeof *in,
+                            key_stable_rec, out);
+                memset(seen, 0, n);
+                for (size_t j = 0; j < n; j++) {
+                    assert(out[j].pos >= 0 && (size_t)out[j].pos < n
+                            && ! seen[out[j].pos]);
+                    seen[out[j].pos] = 1;
+                    assert(j == 0 || out[j-1].key < out[j].key
+                            || (out[j-1].key == out[j].key
+                                && out[j-1].pos < out[j].pos));
+                }
+            }
+        }
+    }
+    free(in);
+    free(out);
+    free(seen);
+    free(keys);
+    free(runs);
+    free(counts);
+}
+
+// Time qs22_kmerge() and qs22_kmerge_key() merging k sorted runs of random
+// keys, num elements in all, for k = 2, 4, ... 1024, against sorting them
+// all again with qs22j. Compares are also shown per element, against lg k;
+// qs22_kmerge_key() compares keys, not calling compar, so it shows none.
+// Each result must equal the keys sorted once beforehand.
+static void run_kmerge_tests(char *test_datatypes, size_t num, int nreps)
+{
+    static const char *methods[] = {"qs22j", "qs22_kmerge",
+        "qs22_kmerge_key"};
+    int *x = mcalloc(num + 1, sizeof(int));
+    double *in = mcalloc(num + 1, sizeof(double));
+    double *out = mcalloc(num + 1, sizeof(double));
+    const void **runs = mcalloc(1024, sizeof *runs);
+    size_t *counts = mcalloc(1024, sizeof *counts);
+    int *sorted = mcalloc(num + 1, sizeof(int));
+    check_kmerge_stable();
+    seed_random31();
+    for (size_t i = 0; i < num; i++)
+        x[i] = sorted[i] = random31();
+    qs22j(sorted, num, sizeof(int), compare_int);
+    for (int dt = 0; dtypes[dt].t; dt++) {
+        int t = dtypes[dt].t;
+        if (! strchr(test_datatypes, t) || (t != 'i' && t != 'd'))
+            continue;
+        size_t size = t == 'i' ? sizeof(int) : sizeof(double);
+        int (*compar)(const void *, const void *) =
+            t == 'i' ? compare_int : compare_double;
+        uint64_t (*key_fn)(const void *) = t == 'i' ? key_int : key_double;
+        printf("Testing %lu %s elements, k sorted runs merged:\n",
+                (UL)num, dtypes[dt].str);
+        printf("     k    Compares  Per elt      Time   Ratio Method\n");
+        for (size_t k = 2; k <= 1024; k *= 2) {
+            ULL compares[3] = {0};
+            ticks_t nticks[3] = {0};
+            for (size_t i = 0; i < k; i++) {
+                runs[i] = (char *)in + i * (num / k) * size;
+                counts[i] = i < k - 1 ? num / k : num - i * (num / k);
+            }
+            for (int repcnt = 0; repcnt < nreps; repcnt++) {
+                for (int m = 0; m < 3; m++) {
+                    for (size_t i = 0; i < num; i++) {
+                        if (t == 'i')
+                            ((int *)in)[i] = x[i];
+                        else
+                            in[i] = x[i];
+                    }
+                    for (size_t i = 0; i < k; i++)
+                        qs22j((void *)runs[i], counts[i], size, compar);
+                    tot_compares = 0;
+                    ticks_t start = get_ticks();
+                    if (m == 0) {
+                        qs22j(in, num, size, compar);
+                        memcpy(out, in, num * size);
+                    } else if (m == 1) {
+                        qs22_kmerge(runs, counts, k, size, compar, out);
+                    } else {
+                        qs22_kmerge_key(runs, counts, k, size, key_fn, out);
+                    }
+                    nticks[m] += get_ticks() - start;
+                    compares[m] += tot_compares;
+                    for (size_t i = 0; i < num; i++)
+                        assert(t == 'i' ? ((int *)out)[i] == sorted[i]
+                                : out[i] == sorted[i]);
+                }
+            }
+            for (int m = 0; m < 3; m++) {
+                printf("%6lu %11llu %8.3f", (UL)k, compares[m] / nreps,
+                        num ? (double)compares[m] / nreps / num : 0.0);
+                showtime(nticks[m] / nreps);
+                printf(" %6.3f %s\n", nticks[0] ?
+                        (double)nticks[m] / nticks[0] : 0.0, methods[m]);
+            }
+        }
     }
+    free(x);
+    free(in);
+    free(out);
+    free(runs);
+    free(counts);
+    free(sorted);
 }
 
 static void show_usage()
@@ -1106,8 +1946,13 @@ int main(int argc, char **argv)
     setvbuf(stdout, NULL, _IOLBF, 0);
     //printf("%s\n", datatypes);
     int nreps = 1;
+    int maxthreads = 0;
+    int opt_latency = 0;
+    int opt_balance = 0;
+    int opt_merge = 0;
+    int opt_kmerge = 0;
     int c;
-    while ((c = getopt(argc, argv, "+hidpszcvmr:n:")) != -1) {
+    while ((c = getopt(argc, argv, "+hidpus3468zcvmlbMKr:n:T:")) != -1) {
         switch (c) {
             case 'h':
                 show_usage();
@@ -1115,7 +1960,12 @@ int main(int argc, char **argv)
             case 'i':
             case 'd':
             case 'p':
+            case 'u':
             case 's':
+            case '3':
+            case '4':
+            case '6':
+            case '8':
                 if (strlen(test_datatypes) >= maxdatatypes) {
                     printf("Too many datatypes requested.\n");
                     return 1;
@@ -1135,12 +1985,27 @@ int main(int argc, char **argv)
             case 'm':
                 opt_small_arrays = 1;
                 break;
+            case 'l':
+                opt_latency = 1;
+                break;
+            case 'b':
+                opt_balance = 1;
+                break;
+            case 'M':
+                opt_merge = 1;
+                break;
+            case 'K':
+                opt_kmerge = 1;
+                break;
             case 'r':
                 nreps = strtoul(optarg, NULL, 10);
                 break;
             case 'n':
                 num = strtoul(optarg, NULL, 10);
                 break;
+            case 'T':
+                maxthreads = strtoul(optarg, NULL, 10);
+                break;
             default:
                 abort();
         }
@@ -1153,6 +2018,36 @@ int main(int argc, char **argv)
     if (! test_datatypes[0])
         strcpy(test_datatypes, datatypes);
     printf("Testing types %s with %lu elements %d times\n", test_datatypes, (UL)num, nreps);
+    if (maxthreads > 0) {
+#if OS_Windows
+        printf("-T is not supported on Windows.\n");
+        return 1;
+#else
+        run_thread_tests(test_datatypes, num, maxthreads, nreps);
+        return 0;
+#endif
+    }
+    if (opt_latency) {
+        run_latency_tests(test_datatypes, nreps);
+        return 0;
+    }
+    if (opt_merge) {
+        run_merge_tests(test_datatypes, num, nreps);
+        return 0;
+    }
+    if (opt_kmerge) {
+        run_kmerge_tests(test_datatypes, num, nreps);
+        return 0;
+    }
+    if (opt_balance) {
+#if COUNTSWAPS
+        run_balance_tests(test_datatypes, num, nreps);
+        return 0;
+#else
+        printf("-b needs a build with COUNTSWAPS.\n");
+        return 1;
+#endif
+    }
     run_tests(test_datatypes, num, use_izabera_tests, check_excess_compares,
             opt_no_half_reversed, opt_small_arrays, nreps);
     return 0;
@@ -0,0 +1,3 @@
+#define qsort qs22j_par
+
+#include "../src/qsorts/rdg/qs22j_par.c"